@@ -0,0 +1,255 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "chunk_mesher.h"
+
+constexpr int ChunkMesher::size;
+constexpr ChunkMesher::BlockId ChunkMesher::air;
+constexpr int ChunkMesher::paddedSize;
+
+namespace
+{
+/// which way a face points and how its texture is laid out, the same as Generate::unitBox
+struct FaceAxes
+{
+    int normalAxis;
+    bool positive;
+    int uAxis;
+    bool uPositive;
+    int vAxis;
+    bool vPositive;
+};
+
+const FaceAxes faceAxes[ChunkMesher::FaceCount] =
+{
+    {0, false, 2, true, 1, true}, // NX
+    {0, true, 2, false, 1, true}, // PX
+    {1, false, 0, true, 2, true}, // NY
+    {1, true, 0, true, 2, false}, // PY
+    {2, false, 0, false, 1, true}, // NZ
+    {2, true, 0, true, 1, true}, // PZ
+};
+
+/// @return if texture can be repeated across several blocks by the GL_REPEAT wrapping that Image::bind sets up
+bool isTileable(const TextureDescriptor &texture)
+{
+    return texture.minU == 0 && texture.maxU == 1 && texture.minV == 0 && texture.maxV == 1;
+}
+}
+
+ChunkMesher::ChunkMesher(PositionI origin, vector<BlockType> blockTypes, function<BlockId(PositionI)> getBlock)
+    : origin(origin), blockTypes(blockTypes), getBlock(getBlock), blocks(paddedSize * paddedSize * paddedSize, air)
+{
+    for(int x = -1; x <= size; x++)
+    {
+        for(int y = -1; y <= size; y++)
+        {
+            for(int z = -1; z <= size; z++)
+            {
+                blocks[blockIndex(x, y, z)] = getBlock(origin + VectorI(x, y, z));
+            }
+        }
+    }
+}
+
+void ChunkMesher::markDirty(VectorI relativePosition)
+{
+    const int position[3] = {relativePosition.x, relativePosition.y, relativePosition.z};
+    for(int face = 0; face < FaceCount; face++)
+    {
+        const FaceAxes &axes = faceAxes[face];
+        int u = position[axes.uAxis], v = position[axes.vAxis];
+        if(u < 0 || u >= size || v < 0 || v >= size)
+            continue;
+        // the block's own face and the faces of the blocks on either side of it
+        for(int layer = position[axes.normalAxis] - 1; layer <= position[axes.normalAxis] + 1; layer++)
+        {
+            if(layer >= 0 && layer < size)
+                slices[face][layer].dirty = true;
+        }
+    }
+    meshesValid = false;
+}
+
+bool ChunkMesher::update(const UpdateList &updates)
+{
+    bool retval = false;
+    for(PositionI pos : updates.updatesList)
+    {
+        if(pos.d != origin.d)
+            continue;
+        VectorI relativePosition = VectorI(pos.x - origin.x, pos.y - origin.y, pos.z - origin.z);
+        if(relativePosition.x < -1 || relativePosition.x > size || relativePosition.y < -1 || relativePosition.y > size || relativePosition.z < -1 || relativePosition.z > size)
+            continue;
+        BlockId &b = blocks[blockIndex(relativePosition.x, relativePosition.y, relativePosition.z)];
+        BlockId newBlock = getBlock(pos);
+        if(newBlock == b)
+            continue;
+        b = newBlock;
+        markDirty(relativePosition);
+        retval = true;
+    }
+    return retval;
+}
+
+void ChunkMesher::buildSlice(Face face, int layer)
+{
+    Slice &slice = slices[face][layer];
+    slice.meshes.clear();
+    slice.dirty = false;
+    const FaceAxes &axes = faceAxes[face];
+    auto getType = [this](BlockId id) -> const BlockType *
+    {
+        if(id == air || id >= blockTypes.size())
+            return nullptr;
+        return &blockTypes[id];
+    };
+    BlockId mask[size * size]; // the visible faces, indexed by v * size + u
+    for(int v = 0; v < size; v++)
+    {
+        for(int u = 0; u < size; u++)
+        {
+            int position[3];
+            position[axes.normalAxis] = layer;
+            position[axes.uAxis] = u;
+            position[axes.vAxis] = v;
+            BlockId id = block(position[0], position[1], position[2]);
+            position[axes.normalAxis] += axes.positive ? 1 : -1;
+            BlockId neighborId = block(position[0], position[1], position[2]);
+            const BlockType *type = getType(id), *neighbor = getType(neighborId);
+            bool visible = type != nullptr && type->faces[face] && (neighbor == nullptr || (!neighbor->opaque && neighborId != id));
+            mask[v * size + u] = visible ? id : air;
+        }
+    }
+    const Color c = Color(1);
+    const float normalPosition = layer + (axes.positive ? 1 : 0);
+    for(int v = 0; v < size; v++)
+    {
+        for(int u = 0; u < size;)
+        {
+            BlockId id = mask[v * size + u];
+            if(id == air)
+            {
+                u++;
+                continue;
+            }
+            const TextureDescriptor &texture = blockTypes[id].faces[face];
+            int w = 1, h = 1;
+            if(isTileable(texture))
+            {
+                while(u + w < size && mask[v * size + u + w] == id)
+                    w++;
+                for(; v + h < size; h++)
+                {
+                    bool rowMatches = true;
+                    for(int du = 0; du < w; du++)
+                    {
+                        if(mask[(v + h) * size + u + du] != id)
+                        {
+                            rowMatches = false;
+                            break;
+                        }
+                    }
+                    if(!rowMatches)
+                        break;
+                }
+            }
+            for(int dv = 0; dv < h; dv++)
+            {
+                for(int du = 0; du < w; du++)
+                {
+                    mask[(v + dv) * size + u + du] = air;
+                }
+            }
+            auto corner = [&](int tu, int tv)
+            {
+                float position[3];
+                position[axes.normalAxis] = normalPosition;
+                position[axes.uAxis] = (axes.uPositive == (tu != 0)) ? u + w : u;
+                position[axes.vAxis] = (axes.vPositive == (tv != 0)) ? v + h : v;
+                return VectorF(position[0], position[1], position[2]);
+            };
+            auto textureCoord = [&](int tu, int tv)
+            {
+                return TextureCoord(texture.minU + tu * w * (texture.maxU - texture.minU), texture.minV + tv * h * (texture.maxV - texture.minV));
+            };
+            Mesh_t *mesh = nullptr;
+            for(Mesh_t &m : slice.meshes)
+            {
+                if(m.texture() == texture.image)
+                {
+                    mesh = &m;
+                    break;
+                }
+            }
+            if(mesh == nullptr)
+            {
+                slice.meshes.push_back(Mesh_t(texture.image));
+                mesh = &slice.meshes.back();
+            }
+            const VectorF p1 = corner(0, 0), p2 = corner(1, 0), p3 = corner(1, 1), p4 = corner(0, 1);
+            const TextureCoord t1 = textureCoord(0, 0), t2 = textureCoord(1, 0), t3 = textureCoord(1, 1), t4 = textureCoord(0, 1);
+            mesh->add(Triangle(p1, c, t1, p2, c, t2, p3, c, t3));
+            mesh->add(Triangle(p3, c, t3, p4, c, t4, p1, c, t1));
+            u += w;
+        }
+    }
+}
+
+const vector<Mesh> &ChunkMesher::meshes()
+{
+    if(meshesValid)
+        return meshesInternal;
+    vector<pair<Face, int>> dirtySlices;
+    for(int face = 0; face < FaceCount; face++)
+    {
+        for(int layer = 0; layer < size; layer++)
+        {
+            if(slices[face][layer].dirty)
+                dirtySlices.push_back(make_pair((Face)face, layer));
+        }
+    }
+    JobSystem::global().parallelFor(dirtySlices.size(), [&](size_t i)
+    {
+        buildSlice(dirtySlices[i].first, dirtySlices[i].second);
+    });
+    vector<Image> images;
+    vector<vector<const Mesh_t *>> parts;
+    for(int face = 0; face < FaceCount; face++)
+    {
+        for(int layer = 0; layer < size; layer++)
+        {
+            for(const Mesh_t &mesh : slices[face][layer].meshes)
+            {
+                size_t index = find(images.begin(), images.end(), mesh.texture()) - images.begin();
+                if(index == images.size())
+                {
+                    images.push_back(mesh.texture());
+                    parts.push_back(vector<const Mesh_t *>());
+                }
+                parts[index].push_back(&mesh);
+            }
+        }
+    }
+    meshesInternal.clear();
+    for(const vector<const Mesh_t *> &imageParts : parts)
+    {
+        meshesInternal.push_back(Mesh_t::merge(imageParts));
+    }
+    meshesValid = true;
+    return meshesInternal;
+}
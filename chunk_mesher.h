@@ -0,0 +1,120 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef CHUNK_MESHER_H_INCLUDED
+#define CHUNK_MESHER_H_INCLUDED
+
+#include "mesh.h"
+#include "position.h"
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+using namespace std;
+
+/** builds the meshes for a 16x16x16 chunk of blocks, with only the faces that can be seen.
+ * faces whose texture is a whole image (so it repeats) are merged with neighboring faces of the same block type into larger rectangles.
+ * faces with textures from part of an image, like the ones in TextureAtlas, are drawn one per block face.
+ * the chunk is meshed as 96 slices, one for each face direction and layer, so a changed block only remeshes the slices around it.
+ */
+class ChunkMesher final
+{
+public:
+    static constexpr int size = 16;
+    typedef uint16_t BlockId;
+    static constexpr BlockId air = 0;
+    enum Face
+    {
+        NX,
+        PX,
+        NY,
+        PY,
+        NZ,
+        PZ,
+        FaceCount
+    };
+    struct BlockType
+    {
+        TextureDescriptor faces[FaceCount]; /// faces without a texture aren't drawn
+        bool opaque = true; /// if this block hides the faces of the blocks next to it
+        BlockType()
+        {
+        }
+        BlockType(TextureDescriptor texture, bool opaque = true)
+            : opaque(opaque)
+        {
+            for(TextureDescriptor &face : faces)
+            {
+                face = texture;
+            }
+        }
+        BlockType(TextureDescriptor nx, TextureDescriptor px, TextureDescriptor ny, TextureDescriptor py, TextureDescriptor nz, TextureDescriptor pz, bool opaque = true)
+            : opaque(opaque)
+        {
+            faces[NX] = nx;
+            faces[PX] = px;
+            faces[NY] = ny;
+            faces[PY] = py;
+            faces[NZ] = nz;
+            faces[PZ] = pz;
+        }
+    };
+private:
+    static constexpr int paddedSize = size + 2; // the blocks next to the chunk are kept to check if the faces on the edge can be seen
+    struct Slice
+    {
+        vector<Mesh_t> meshes; // one for each image
+        bool dirty = true;
+    };
+    PositionI origin;
+    vector<BlockType> blockTypes;
+    function<BlockId(PositionI)> getBlock;
+    vector<BlockId> blocks; // paddedSize^3, indexed by position relative to origin plus 1
+    Slice slices[FaceCount][size];
+    vector<Mesh> meshesInternal;
+    bool meshesValid = false;
+    static size_t blockIndex(int x, int y, int z)
+    {
+        return ((size_t)(x + 1) * paddedSize + (size_t)(y + 1)) * paddedSize + (size_t)(z + 1);
+    }
+    BlockId block(int x, int y, int z) const
+    {
+        return blocks[blockIndex(x, y, z)];
+    }
+    void markDirty(VectorI relativePosition);
+    void buildSlice(Face face, int layer);
+public:
+    /** @param origin the position of the block in the chunk with the smallest coordinates
+     * @param blockTypes the types of blocks, indexed by BlockId. blockTypes[air] isn't used.
+     * @param getBlock called to find the block at a position, both inside the chunk and next to it
+     */
+    ChunkMesher(PositionI origin, vector<BlockType> blockTypes, function<BlockId(PositionI)> getBlock);
+    PositionI getOrigin() const
+    {
+        return origin;
+    }
+    /** reread the blocks at the positions in updates and remesh the slices they can change.
+     * positions that aren't in or next to this chunk are ignored.
+     *
+     * @return if anything needs to be remeshed
+     */
+    bool update(const UpdateList &updates);
+    /// @return the meshes for the chunk, one for each image, relative to the origin. they are only rebuilt after update changes something.
+    const vector<Mesh> &meshes();
+};
+
+#endif // CHUNK_MESHER_H_INCLUDED
@@ -20,7 +20,11 @@
 
 #include <cstdint>
 #include <ostream>
+#include <cstddef>
 #include "util.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 using namespace std;
 
@@ -93,6 +97,34 @@ struct Color final
     }
 };
 
+/** scale packed colors in place
+ *
+ * @param factor the color to scale by
+ * @param rgba the colors, stored as r, g, b, a, r, g, b, a, ...
+ * @param n the number of colors
+ */
+inline void scaleColors(Color factor, float * rgba, size_t n)
+{
+    size_t i = 0;
+#ifdef __SSE__
+    const __m128 f = _mm_setr_ps(factor.r, factor.g, factor.b, factor.a);
+    for(; i + 4 <= n; i += 4, rgba += 16)
+    {
+        _mm_storeu_ps(rgba, _mm_mul_ps(_mm_loadu_ps(rgba), f));
+        _mm_storeu_ps(rgba + 4, _mm_mul_ps(_mm_loadu_ps(rgba + 4), f));
+        _mm_storeu_ps(rgba + 8, _mm_mul_ps(_mm_loadu_ps(rgba + 8), f));
+        _mm_storeu_ps(rgba + 12, _mm_mul_ps(_mm_loadu_ps(rgba + 12), f));
+    }
+#endif
+    for(; i < n; i++, rgba += 4)
+    {
+        rgba[0] *= factor.r;
+        rgba[1] *= factor.g;
+        rgba[2] *= factor.b;
+        rgba[3] *= factor.a;
+    }
+}
+
 template <>
 inline const Color interpolate<Color>(const float t, const Color a, const Color b)
 {
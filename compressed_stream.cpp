@@ -20,6 +20,1338 @@
 #include <iostream>
 #include <cstdlib>
 #include <thread>
+#include <queue>
+#include <functional>
+#include <cstring>
+
+namespace
+{
+/** the Huffman format's blocks, each byte aligned :
+ * a block type byte, then for stored blocks a big endian 32 bit length and the bytes,
+ * for fixed blocks the codes up to endOfBlock using fixedCodeLengths,
+ * or for Huffman blocks the code lengths and then the codes up to endOfBlock.
+ * Huffman blocks send how many literal/length codes past 257 in 5 bits, how many distance codes past 1 in 5 bits
+ * and how many code length codes past 4 in 4 bits, then that many code length code lengths in 3 bits each
+ * in codeLengthOrder, then the literal/length and distance code lengths coded with them.
+ * code lengths are 0 to maxCodeLength, repeatLength repeats the last length 3 to 6 times,
+ * repeatZero sends 3 to 10 zeros and repeatManyZeros sends 11 to 138 zeros.
+ * bits are packed starting at the least significant bit and codes are canonical, sent with their first bit first.
+ */
+struct HuffmanFormat final
+{
+    static constexpr uint8_t storedBlock = 1, huffmanBlock = 2, fixedBlock = 3;
+    static constexpr unsigned endOfBlock = 256;
+    static constexpr unsigned literalCodeCount = 286, distanceCodeCount = 32;
+    static constexpr unsigned maxCodeLength = 12;
+    static constexpr unsigned repeatLength = 16, repeatZero = 17, repeatManyZeros = 18, codeLengthCodeCount = 19;
+    static constexpr unsigned maxCodeLengthCodeLength = 7, codeLengthCodeLengthBits = 3;
+    static const uint8_t codeLengthOrder[codeLengthCodeCount];
+    static constexpr size_t minMatch = 3, maxMatch = 258;
+    static const uint16_t lengthBase[literalCodeCount - endOfBlock - 1];
+    static const uint8_t lengthExtraBits[literalCodeCount - endOfBlock - 1];
+    static unsigned lengthCode(size_t length)
+    {
+        unsigned code = 0;
+        while(code + 1 < sizeof(lengthBase) / sizeof(lengthBase[0]) && lengthBase[code + 1] <= length)
+            code++;
+        return code;
+    }
+    /// distance - 1 is split into a code made of its top 2 bits and their position, and the rest as extra bits
+    static unsigned distanceCode(size_t distance)
+    {
+        size_t x = distance - 1;
+        if(x < 4)
+            return x;
+        unsigned k = 0;
+        while((x >> (k + 1)) != 0)
+            k++;
+        return 2 * k + ((x >> (k - 1)) & 1);
+    }
+    static unsigned distanceExtraBits(unsigned code)
+    {
+        return code < 4 ? 0 : code / 2 - 1;
+    }
+    static unsigned codeLengthExtraBits(unsigned symbol)
+    {
+        return symbol == repeatLength ? 2 : symbol == repeatZero ? 3 : symbol == repeatManyZeros ? 7 : 0;
+    }
+    /// the literal/length code lengths then the distance code lengths for fixed blocks
+    static void fixedCodeLengths(uint8_t * lengths)
+    {
+        for(unsigned i = 0; i < literalCodeCount; i++)
+            lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        for(unsigned i = 0; i < distanceCodeCount; i++)
+            lengths[literalCodeCount + i] = 5;
+    }
+    static size_t distanceBase(unsigned code)
+    {
+        if(code < 4)
+            return code + 1;
+        unsigned extraBits = distanceExtraBits(code);
+        return ((size_t)(2 | (code & 1)) << extraBits) + 1;
+    }
+};
+
+constexpr uint8_t HuffmanFormat::storedBlock, HuffmanFormat::huffmanBlock, HuffmanFormat::fixedBlock;
+constexpr unsigned HuffmanFormat::endOfBlock, HuffmanFormat::literalCodeCount, HuffmanFormat::distanceCodeCount;
+constexpr unsigned HuffmanFormat::maxCodeLength;
+constexpr unsigned HuffmanFormat::repeatLength, HuffmanFormat::repeatZero, HuffmanFormat::repeatManyZeros, HuffmanFormat::codeLengthCodeCount;
+constexpr unsigned HuffmanFormat::maxCodeLengthCodeLength, HuffmanFormat::codeLengthCodeLengthBits;
+
+const uint8_t HuffmanFormat::codeLengthOrder[] =
+{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+constexpr size_t HuffmanFormat::minMatch, HuffmanFormat::maxMatch;
+
+const uint16_t HuffmanFormat::lengthBase[] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+const uint8_t HuffmanFormat::lengthExtraBits[] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+unsigned reverseBits(unsigned v, unsigned bitCount)
+{
+    unsigned retval = 0;
+    for(unsigned i = 0; i < bitCount; i++)
+    {
+        retval = (retval << 1) | (v & 1);
+        v >>= 1;
+    }
+    return retval;
+}
+
+/// @return the canonical codes for lengths, bit reversed so the first bit is the least significant
+vector<uint16_t> makeCodes(const uint8_t * lengths, size_t count)
+{
+    unsigned lengthCounts[HuffmanFormat::maxCodeLength + 1] = {};
+    for(size_t i = 0; i < count; i++)
+        lengthCounts[lengths[i]]++;
+    lengthCounts[0] = 0;
+    unsigned nextCode[HuffmanFormat::maxCodeLength + 1] = {};
+    unsigned code = 0;
+    for(unsigned length = 1; length <= HuffmanFormat::maxCodeLength; length++)
+    {
+        code = (code + lengthCounts[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+    vector<uint16_t> retval(count, 0);
+    for(size_t i = 0; i < count; i++)
+    {
+        if(lengths[i] != 0)
+            retval[i] = reverseBits(nextCode[lengths[i]]++, lengths[i]);
+    }
+    return retval;
+}
+
+/// Huffman code lengths for frequencies, limited to maxLength by flattening the frequencies until they fit
+void makeCodeLengths(const uint32_t * frequencies, uint8_t * lengths, size_t count, unsigned maxLength = HuffmanFormat::maxCodeLength)
+{
+    vector<uint32_t> weights(frequencies, frequencies + count);
+    while(true)
+    {
+        fill(lengths, lengths + count, 0);
+        // nodes 0 to count - 1 are the symbols, after that the internal nodes
+        vector<size_t> parent(count, 0);
+        typedef pair<uint64_t, size_t> Node;
+        priority_queue<Node, vector<Node>, greater<Node>> queue;
+        for(size_t i = 0; i < count; i++)
+        {
+            if(weights[i] != 0)
+                queue.push(Node(weights[i], i));
+        }
+        if(queue.empty())
+            return;
+        if(queue.size() == 1)
+        {
+            lengths[queue.top().second] = 1;
+            return;
+        }
+        while(queue.size() > 1)
+        {
+            Node a = queue.top();
+            queue.pop();
+            Node b = queue.top();
+            queue.pop();
+            size_t node = parent.size();
+            parent.push_back(0);
+            parent[a.second] = node;
+            parent[b.second] = node;
+            queue.push(Node(a.first + b.first, node));
+        }
+        size_t root = queue.top().second;
+        vector<unsigned> depth(parent.size(), 0);
+        bool fits = true;
+        for(size_t node = parent.size(); node-- > 0;) // parents are always after their children
+        {
+            if(node != root)
+                depth[node] = depth[parent[node]] + 1;
+        }
+        for(size_t i = 0; i < count; i++)
+        {
+            if(weights[i] == 0)
+                continue;
+            if(depth[i] > maxLength)
+                fits = false;
+            lengths[i] = depth[i];
+        }
+        if(fits)
+            return;
+        for(uint32_t &weight : weights)
+        {
+            if(weight != 0)
+                weight = (weight + 1) / 2;
+        }
+    }
+}
+
+/// a symbol of the code length alphabet and its extra bits
+struct CodeLengthSymbol final
+{
+    uint8_t symbol, extra;
+};
+
+/// run length code lengths with the repeat symbols
+vector<CodeLengthSymbol> runLengthCode(const uint8_t * lengths, size_t count)
+{
+    vector<CodeLengthSymbol> retval;
+    for(size_t i = 0; i < count;)
+    {
+        uint8_t length = lengths[i];
+        size_t run = 1;
+        while(i + run < count && lengths[i + run] == length)
+            run++;
+        i += run;
+        if(length == 0)
+        {
+            for(; run >= 11; run -= min<size_t>(run, 138))
+                retval.push_back(CodeLengthSymbol{(uint8_t)HuffmanFormat::repeatManyZeros, (uint8_t)(min<size_t>(run, 138) - 11)});
+            if(run >= 3)
+            {
+                retval.push_back(CodeLengthSymbol{(uint8_t)HuffmanFormat::repeatZero, (uint8_t)(run - 3)});
+                run = 0;
+            }
+        }
+        else
+        {
+            retval.push_back(CodeLengthSymbol{length, 0});
+            for(run--; run >= 3; run -= min<size_t>(run, 6))
+                retval.push_back(CodeLengthSymbol{(uint8_t)HuffmanFormat::repeatLength, (uint8_t)(min<size_t>(run, 6) - 3)});
+        }
+        for(; run > 0; run--)
+            retval.push_back(CodeLengthSymbol{length, 0});
+    }
+    return retval;
+}
+
+class BitWriter final
+{
+private:
+    vector<uint8_t> &output;
+    uint64_t bits = 0;
+    unsigned bitCount = 0;
+public:
+    BitWriter(vector<uint8_t> &output)
+        : output(output)
+    {
+    }
+    void write(uint32_t value, unsigned count)
+    {
+        bits |= (uint64_t)value << bitCount;
+        bitCount += count;
+        while(bitCount >= 8)
+        {
+            output.push_back((uint8_t)bits);
+            bits >>= 8;
+            bitCount -= 8;
+        }
+    }
+    void align()
+    {
+        if(bitCount > 0)
+            output.push_back((uint8_t)bits);
+        bits = 0;
+        bitCount = 0;
+    }
+};
+
+typedef uint16_t HuffmanTable[1 << HuffmanFormat::maxCodeLength];
+
+/// fill a table indexed by the next maxCodeLength bits with symbol << 4 | code length, 0 for invalid codes
+void makeTable(HuffmanTable &table, const uint8_t * lengths, size_t count)
+{
+    fill(begin(table), end(table), 0);
+    vector<uint16_t> codes = makeCodes(lengths, count);
+    for(size_t symbol = 0; symbol < count; symbol++)
+    {
+        unsigned length = lengths[symbol];
+        if(length == 0)
+            continue;
+        for(size_t i = codes[symbol]; i < sizeof(table) / sizeof(table[0]); i += (size_t)1 << length)
+        {
+            if(table[i] != 0) // over-subscribed lengths
+                throw LZ77FormatException();
+            table[i] = (uint16_t)(symbol << 4 | length);
+        }
+    }
+}
+}
+
+class HuffmanExpander final
+{
+private:
+    enum class State
+    {
+        BlockStart,
+        Stored,
+        Huffman
+    };
+    static constexpr size_t windowMask = LZContainerFormat::windowSize - 1;
+    /// enough bits for any length and distance code with their extra bits
+    static constexpr size_t maxTokenBits = 2 * HuffmanFormat::maxCodeLength + 5 + 14;
+    shared_ptr<Reader> reader;
+    uint8_t input[4096];
+    size_t inputPosition = 0, inputEnd = 0;
+    uint64_t bits = 0;
+    unsigned bitCount = 0;
+    State state = State::BlockStart;
+    size_t storedRemaining = 0;
+    HuffmanTable literalTable, distanceTable, codeLengthTable;
+    vector<uint8_t> window;
+    size_t outputCount = 0;
+    size_t matchRemaining = 0, matchDistance = 0;
+    void fillInput()
+    {
+        try
+        {
+            inputEnd = reader->readUpTo(input, sizeof(input));
+            inputPosition = 0;
+        }
+        catch(EOFException &e)
+        {
+            throw LZ77FormatException();
+        }
+    }
+    void moveInputToBits()
+    {
+        while(bitCount <= 56 && inputPosition < inputEnd)
+        {
+            bits |= (uint64_t)input[inputPosition++] << bitCount;
+            bitCount += 8;
+        }
+    }
+    size_t bitsAvailable() const
+    {
+        return bitCount + 8 * (inputEnd - inputPosition);
+    }
+    unsigned getBits(unsigned count)
+    {
+        while(bitCount < count)
+        {
+            if(inputPosition == inputEnd)
+                fillInput();
+            moveInputToBits();
+        }
+        unsigned retval = (unsigned)(bits & (((uint64_t)1 << count) - 1));
+        bits >>= count;
+        bitCount -= count;
+        return retval;
+    }
+    unsigned decodeSymbol(const HuffmanTable &table)
+    {
+        moveInputToBits();
+        while(true)
+        {
+            uint16_t entry = table[bits & ((1 << HuffmanFormat::maxCodeLength) - 1)];
+            unsigned length = entry & 0xF;
+            if(length != 0 && length <= bitCount)
+            {
+                bits >>= length;
+                bitCount -= length;
+                return entry >> 4;
+            }
+            if(bitCount >= HuffmanFormat::maxCodeLength)
+                throw LZ77FormatException();
+            if(inputPosition == inputEnd)
+                fillInput();
+            moveInputToBits();
+        }
+    }
+    void alignToByte()
+    {
+        unsigned skip = bitCount % 8;
+        bits >>= skip;
+        bitCount -= skip;
+    }
+    /// read a Huffman block's code lengths into the literal/length then distance code lengths
+    void readCodeLengths(uint8_t * lengths)
+    {
+        size_t literalCount = getBits(5) + HuffmanFormat::endOfBlock + 1;
+        size_t distanceCount = getBits(5) + 1;
+        size_t codeLengthCodeCount = getBits(4) + 4;
+        if(literalCount > HuffmanFormat::literalCodeCount)
+            throw LZ77FormatException();
+        uint8_t codeLengthCodeLengths[HuffmanFormat::codeLengthCodeCount] = {};
+        for(size_t i = 0; i < codeLengthCodeCount; i++)
+            codeLengthCodeLengths[HuffmanFormat::codeLengthOrder[i]] = getBits(HuffmanFormat::codeLengthCodeLengthBits);
+        makeTable(codeLengthTable, codeLengthCodeLengths, HuffmanFormat::codeLengthCodeCount);
+        uint8_t sentLengths[HuffmanFormat::literalCodeCount + HuffmanFormat::distanceCodeCount];
+        size_t sentCount = literalCount + distanceCount;
+        for(size_t i = 0; i < sentCount;)
+        {
+            unsigned symbol = decodeSymbol(codeLengthTable);
+            uint8_t length = 0;
+            size_t run = 1;
+            if(symbol == HuffmanFormat::repeatLength)
+            {
+                if(i == 0)
+                    throw LZ77FormatException();
+                length = sentLengths[i - 1];
+                run = 3 + getBits(2);
+            }
+            else if(symbol == HuffmanFormat::repeatZero)
+                run = 3 + getBits(3);
+            else if(symbol == HuffmanFormat::repeatManyZeros)
+                run = 11 + getBits(7);
+            else if(symbol <= HuffmanFormat::maxCodeLength)
+                length = symbol;
+            else
+                throw LZ77FormatException();
+            if(run > sentCount - i)
+                throw LZ77FormatException();
+            for(; run > 0; run--)
+                sentLengths[i++] = length;
+        }
+        fill(lengths, lengths + HuffmanFormat::literalCodeCount + HuffmanFormat::distanceCodeCount, 0);
+        copy(&sentLengths[0], &sentLengths[literalCount], &lengths[0]);
+        copy(&sentLengths[literalCount], &sentLengths[sentCount], &lengths[HuffmanFormat::literalCodeCount]);
+    }
+    void startBlock()
+    {
+        if(bitCount == 0 && inputPosition == inputEnd)
+        {
+            inputEnd = reader->readUpTo(input, sizeof(input)); // EOF between blocks is the end of the stream
+            inputPosition = 0;
+        }
+        uint8_t blockType = getBits(8);
+        if(blockType == HuffmanFormat::storedBlock)
+        {
+            storedRemaining = 0;
+            for(int i = 0; i < 4; i++)
+                storedRemaining = storedRemaining << 8 | getBits(8);
+            state = State::Stored;
+        }
+        else if(blockType == HuffmanFormat::huffmanBlock || blockType == HuffmanFormat::fixedBlock)
+        {
+            uint8_t lengths[HuffmanFormat::literalCodeCount + HuffmanFormat::distanceCodeCount];
+            if(blockType == HuffmanFormat::fixedBlock)
+                HuffmanFormat::fixedCodeLengths(lengths);
+            else
+                readCodeLengths(lengths);
+            makeTable(literalTable, &lengths[0], HuffmanFormat::literalCodeCount);
+            makeTable(distanceTable, &lengths[HuffmanFormat::literalCodeCount], HuffmanFormat::distanceCodeCount);
+            state = State::Huffman;
+        }
+        else
+            throw LZ77FormatException();
+    }
+    void output(uint8_t * array, uint8_t v)
+    {
+        *array = v;
+        window[outputCount++ & windowMask] = v;
+    }
+public:
+    HuffmanExpander(shared_ptr<Reader> reader)
+        : reader(reader), window(LZContainerFormat::windowSize)
+    {
+    }
+    /** decode count bytes, or if partial is set stop after the first byte once decoding more would
+     * need to wait for input
+     */
+    size_t read(uint8_t * array, size_t count, bool partial)
+    {
+        size_t retval = 0;
+        while(retval < count)
+        {
+            if(matchRemaining > 0)
+            {
+                size_t copyCount = min(matchRemaining, count - retval);
+                matchRemaining -= copyCount;
+                for(size_t i = 0; i < copyCount; i++)
+                    output(&array[retval++], window[(outputCount - matchDistance) & windowMask]);
+                continue;
+            }
+            switch(state)
+            {
+            case State::BlockStart:
+                if(partial && retval > 0 && bitsAvailable() < 8)
+                    return retval;
+                startBlock();
+                break;
+            case State::Stored:
+            {
+                if(storedRemaining == 0)
+                {
+                    state = State::BlockStart;
+                    break;
+                }
+                alignToByte();
+                if(bitCount > 0)
+                {
+                    output(&array[retval++], getBits(8));
+                    storedRemaining--;
+                    break;
+                }
+                if(inputPosition == inputEnd)
+                {
+                    if(partial && retval > 0)
+                        return retval;
+                    fillInput();
+                }
+                size_t copyCount = min(min(storedRemaining, count - retval), inputEnd - inputPosition);
+                storedRemaining -= copyCount;
+                for(size_t i = 0; i < copyCount; i++)
+                    output(&array[retval++], input[inputPosition++]);
+                break;
+            }
+            case State::Huffman:
+            {
+                if(partial && retval > 0 && bitsAvailable() < maxTokenBits)
+                    return retval;
+                unsigned symbol = decodeSymbol(literalTable);
+                if(symbol < HuffmanFormat::endOfBlock)
+                {
+                    output(&array[retval++], symbol);
+                    break;
+                }
+                if(symbol == HuffmanFormat::endOfBlock)
+                {
+                    alignToByte();
+                    state = State::BlockStart;
+                    break;
+                }
+                unsigned lengthCode = symbol - HuffmanFormat::endOfBlock - 1;
+                size_t length = HuffmanFormat::lengthBase[lengthCode] + getBits(HuffmanFormat::lengthExtraBits[lengthCode]);
+                unsigned distanceCode = decodeSymbol(distanceTable);
+                size_t distance = HuffmanFormat::distanceBase(distanceCode) + getBits(HuffmanFormat::distanceExtraBits(distanceCode));
+                if(distance > outputCount || distance > LZContainerFormat::windowSize)
+                    throw LZ77FormatException();
+                matchRemaining = length;
+                matchDistance = distance;
+                break;
+            }
+            }
+        }
+        return retval;
+    }
+};
+
+/** finds matches with hash chains and lazy matching, and writes them as one block.
+ * positions are relative to the start of the data passed to encodeBlock
+ */
+class HuffmanEncoder final
+{
+private:
+    static constexpr unsigned hashBits = 15;
+    static constexpr size_t windowMask = LZContainerFormat::windowSize - 1;
+    static constexpr size_t maxChainLength = 128, niceLength = 128;
+    /// don't look for a longer match at the next byte after a match at least this long
+    static constexpr size_t maxLazyLength = 32;
+    /// 3 byte matches further away than this cost more than the literals
+    static constexpr size_t tooFar = 4096;
+    static constexpr int32_t noPosition = -1;
+    vector<int32_t> head, prev;
+    size_t insertPosition = 0;
+    struct Token final
+    {
+        uint16_t length; // 0 for a literal
+        uint16_t literal;
+        uint32_t distance;
+    };
+    vector<Token> tokens;
+    static size_t hash(const uint8_t * data)
+    {
+        uint32_t v = (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16;
+        return (v * 2654435761U) >> (32 - hashBits);
+    }
+    void insertUpTo(const uint8_t * data, size_t position, size_t end)
+    {
+        for(; insertPosition < position && insertPosition + HuffmanFormat::minMatch <= end; insertPosition++)
+        {
+            size_t h = hash(&data[insertPosition]);
+            prev[insertPosition & windowMask] = head[h];
+            head[h] = (int32_t)insertPosition;
+        }
+    }
+    /// @return the length of the longest match at position, setting distance
+    size_t findMatch(const uint8_t * data, size_t position, size_t end, size_t &distance)
+    {
+        size_t maxLength = min(HuffmanFormat::maxMatch, end - position);
+        if(maxLength < HuffmanFormat::minMatch)
+            return 0;
+        size_t bestLength = HuffmanFormat::minMatch - 1;
+        int32_t candidate = head[hash(&data[position])];
+        const uint8_t * current = &data[position];
+        for(size_t chain = 0; chain < maxChainLength && candidate != noPosition; chain++)
+        {
+            size_t candidatePosition = candidate;
+            if(candidatePosition >= position || position - candidatePosition > LZContainerFormat::windowSize)
+                break;
+            const uint8_t * match = &data[candidatePosition];
+            if(match[bestLength] == current[bestLength] && match[0] == current[0])
+            {
+                size_t length = 0;
+                while(length + sizeof(uint64_t) <= maxLength)
+                {
+                    uint64_t a, b;
+                    memcpy((void *)&a, (const void *)&match[length], sizeof(a));
+                    memcpy((void *)&b, (const void *)&current[length], sizeof(b));
+                    if(a != b)
+                        break;
+                    length += sizeof(uint64_t);
+                }
+                while(length < maxLength && match[length] == current[length])
+                    length++;
+                if(length > bestLength)
+                {
+                    bestLength = length;
+                    distance = position - candidatePosition;
+                    if(length >= niceLength || length == maxLength)
+                        break;
+                }
+            }
+            candidate = prev[candidatePosition & windowMask];
+        }
+        if(bestLength < HuffmanFormat::minMatch || (bestLength == HuffmanFormat::minMatch && distance > tooFar))
+            return 0;
+        return bestLength;
+    }
+    void addLiteral(uint8_t v)
+    {
+        tokens.push_back(Token{0, v, 0});
+    }
+    void addMatch(size_t length, size_t distance)
+    {
+        tokens.push_back(Token{(uint16_t)length, 0, (uint32_t)distance});
+    }
+    void writeTokens(const uint8_t * data, size_t start, size_t end, vector<uint8_t> &output)
+    {
+        uint32_t literalFrequencies[HuffmanFormat::literalCodeCount] = {};
+        uint32_t distanceFrequencies[HuffmanFormat::distanceCodeCount] = {};
+        size_t extraBits = 0;
+        for(const Token &token : tokens)
+        {
+            if(token.length == 0)
+            {
+                literalFrequencies[token.literal]++;
+                continue;
+            }
+            unsigned lengthCode = HuffmanFormat::lengthCode(token.length);
+            literalFrequencies[HuffmanFormat::endOfBlock + 1 + lengthCode]++;
+            unsigned distanceCode = HuffmanFormat::distanceCode(token.distance);
+            distanceFrequencies[distanceCode]++;
+            extraBits += HuffmanFormat::lengthExtraBits[lengthCode] + HuffmanFormat::distanceExtraBits(distanceCode);
+        }
+        literalFrequencies[HuffmanFormat::endOfBlock]++;
+        uint8_t lengths[HuffmanFormat::literalCodeCount + HuffmanFormat::distanceCodeCount];
+        uint8_t fixedLengths[HuffmanFormat::literalCodeCount + HuffmanFormat::distanceCodeCount];
+        makeCodeLengths(literalFrequencies, &lengths[0], HuffmanFormat::literalCodeCount);
+        makeCodeLengths(distanceFrequencies, &lengths[HuffmanFormat::literalCodeCount], HuffmanFormat::distanceCodeCount);
+        HuffmanFormat::fixedCodeLengths(fixedLengths);
+        auto codedBits = [&](const uint8_t * codeLengths)
+        {
+            size_t retval = extraBits;
+            for(size_t i = 0; i < HuffmanFormat::literalCodeCount; i++)
+                retval += (size_t)literalFrequencies[i] * codeLengths[i];
+            for(size_t i = 0; i < HuffmanFormat::distanceCodeCount; i++)
+                retval += (size_t)distanceFrequencies[i] * codeLengths[HuffmanFormat::literalCodeCount + i];
+            return retval;
+        };
+
+        // the code lengths that are sent, without the unused codes at the end
+        size_t literalCount = HuffmanFormat::literalCodeCount, distanceCount = HuffmanFormat::distanceCodeCount;
+        while(literalCount > HuffmanFormat::endOfBlock + 1 && lengths[literalCount - 1] == 0)
+            literalCount--;
+        while(distanceCount > 1 && lengths[HuffmanFormat::literalCodeCount + distanceCount - 1] == 0)
+            distanceCount--;
+        uint8_t sentLengths[HuffmanFormat::literalCodeCount + HuffmanFormat::distanceCodeCount];
+        copy(&lengths[0], &lengths[literalCount], &sentLengths[0]);
+        copy(&lengths[HuffmanFormat::literalCodeCount], &lengths[HuffmanFormat::literalCodeCount + distanceCount], &sentLengths[literalCount]);
+        vector<CodeLengthSymbol> codeLengthSymbols = runLengthCode(sentLengths, literalCount + distanceCount);
+        uint32_t codeLengthFrequencies[HuffmanFormat::codeLengthCodeCount] = {};
+        for(CodeLengthSymbol symbol : codeLengthSymbols)
+            codeLengthFrequencies[symbol.symbol]++;
+        uint8_t codeLengthCodeLengths[HuffmanFormat::codeLengthCodeCount];
+        makeCodeLengths(codeLengthFrequencies, codeLengthCodeLengths, HuffmanFormat::codeLengthCodeCount, HuffmanFormat::maxCodeLengthCodeLength);
+        size_t codeLengthCodeCount = HuffmanFormat::codeLengthCodeCount;
+        while(codeLengthCodeCount > 4 && codeLengthCodeLengths[HuffmanFormat::codeLengthOrder[codeLengthCodeCount - 1]] == 0)
+            codeLengthCodeCount--;
+
+        size_t huffmanBits = 8 + 5 + 5 + 4 + codeLengthCodeCount * HuffmanFormat::codeLengthCodeLengthBits + codedBits(lengths);
+        for(CodeLengthSymbol symbol : codeLengthSymbols)
+            huffmanBits += codeLengthCodeLengths[symbol.symbol] + HuffmanFormat::codeLengthExtraBits(symbol.symbol);
+        size_t fixedBits = 8 + codedBits(fixedLengths);
+        size_t storedBits = 8 * (5 + end - start);
+        if(storedBits <= huffmanBits && storedBits <= fixedBits)
+        {
+            size_t length = end - start;
+            output.push_back(HuffmanFormat::storedBlock);
+            for(int shift = 24; shift >= 0; shift -= 8)
+                output.push_back((uint8_t)(length >> shift));
+            output.insert(output.end(), &data[start], &data[end]);
+            return;
+        }
+        bool useFixed = fixedBits <= huffmanBits;
+        const uint8_t * literalLengths = useFixed ? &fixedLengths[0] : &lengths[0];
+        const uint8_t * distanceLengths = literalLengths + HuffmanFormat::literalCodeCount;
+        vector<uint16_t> literalCodes = makeCodes(literalLengths, HuffmanFormat::literalCodeCount);
+        vector<uint16_t> distanceCodes = makeCodes(distanceLengths, HuffmanFormat::distanceCodeCount);
+        output.reserve(output.size() + min(huffmanBits, fixedBits) / 8 + 1);
+        BitWriter writer(output);
+        if(useFixed)
+            writer.write(HuffmanFormat::fixedBlock, 8);
+        else
+        {
+            writer.write(HuffmanFormat::huffmanBlock, 8);
+            writer.write(literalCount - HuffmanFormat::endOfBlock - 1, 5);
+            writer.write(distanceCount - 1, 5);
+            writer.write(codeLengthCodeCount - 4, 4);
+            for(size_t i = 0; i < codeLengthCodeCount; i++)
+                writer.write(codeLengthCodeLengths[HuffmanFormat::codeLengthOrder[i]], HuffmanFormat::codeLengthCodeLengthBits);
+            vector<uint16_t> codeLengthCodes = makeCodes(codeLengthCodeLengths, HuffmanFormat::codeLengthCodeCount);
+            for(CodeLengthSymbol symbol : codeLengthSymbols)
+            {
+                writer.write(codeLengthCodes[symbol.symbol], codeLengthCodeLengths[symbol.symbol]);
+                writer.write(symbol.extra, HuffmanFormat::codeLengthExtraBits(symbol.symbol));
+            }
+        }
+        for(const Token &token : tokens)
+        {
+            if(token.length == 0)
+            {
+                writer.write(literalCodes[token.literal], literalLengths[token.literal]);
+                continue;
+            }
+            unsigned lengthCode = HuffmanFormat::lengthCode(token.length);
+            unsigned symbol = HuffmanFormat::endOfBlock + 1 + lengthCode;
+            writer.write(literalCodes[symbol], literalLengths[symbol]);
+            writer.write(token.length - HuffmanFormat::lengthBase[lengthCode], HuffmanFormat::lengthExtraBits[lengthCode]);
+            unsigned distanceCode = HuffmanFormat::distanceCode(token.distance);
+            writer.write(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+            writer.write(token.distance - HuffmanFormat::distanceBase(distanceCode), HuffmanFormat::distanceExtraBits(distanceCode));
+        }
+        writer.write(literalCodes[HuffmanFormat::endOfBlock], literalLengths[HuffmanFormat::endOfBlock]);
+        writer.align();
+    }
+public:
+    HuffmanEncoder()
+        : head((size_t)1 << hashBits, noPosition), prev(LZContainerFormat::windowSize, noPosition)
+    {
+    }
+    /** append a block encoding data[start] to data[end] to output, using data[0] to data[start] as history.
+     * calls must be in order over the same data unless slide is called between them
+     */
+    void encodeBlock(const uint8_t * data, size_t start, size_t end, vector<uint8_t> &output)
+    {
+        tokens.clear();
+        size_t position = start;
+        bool havePrevious = false;
+        size_t previousLength = 0, previousDistance = 0;
+        while(position < end)
+        {
+            insertUpTo(data, position, end);
+            size_t distance = 0;
+            size_t length = 0;
+            if(!havePrevious || previousLength < maxLazyLength)
+                length = findMatch(data, position, end, distance);
+            if(havePrevious)
+            {
+                if(length > previousLength)
+                {
+                    addLiteral(data[position - 1]);
+                    previousLength = length;
+                    previousDistance = distance;
+                    position++;
+                    continue;
+                }
+                addMatch(previousLength, previousDistance);
+                position += previousLength - 1;
+                havePrevious = false;
+                continue;
+            }
+            if(length >= niceLength)
+            {
+                addMatch(length, distance);
+                position += length;
+                continue;
+            }
+            if(length > 0)
+            {
+                havePrevious = true;
+                previousLength = length;
+                previousDistance = distance;
+                position++;
+                continue;
+            }
+            addLiteral(data[position++]);
+        }
+        if(havePrevious)
+            addMatch(previousLength, previousDistance);
+        writeTokens(data, start, end, output);
+    }
+    /// the data moved back by windowSize bytes
+    void slide()
+    {
+        for(int32_t &position : head)
+            position = position >= (int32_t)LZContainerFormat::windowSize ? position - (int32_t)LZContainerFormat::windowSize : noPosition;
+        for(int32_t &position : prev)
+            position = position >= (int32_t)LZContainerFormat::windowSize ? position - (int32_t)LZContainerFormat::windowSize : noPosition;
+        insertPosition -= LZContainerFormat::windowSize;
+    }
+};
+
+namespace
+{
+void appendU32(vector<uint8_t> &output, uint32_t v)
+{
+    for(int shift = 24; shift >= 0; shift -= 8)
+        output.push_back((uint8_t)(v >> shift));
+}
+
+uint32_t decodeU32(const uint8_t * bytes)
+{
+    return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+void appendBlocksHeader(vector<uint8_t> &output, size_t blockSize)
+{
+    output.push_back(LZContainerFormat::magic0);
+    output.push_back(LZContainerFormat::magic1);
+    output.push_back(LZContainerFormat::blocksVersion);
+    appendU32(output, blockSize);
+}
+
+/// decompress a block written by BlockCompressWriter into count bytes at array
+void expandBlock(shared_ptr<Reader> compressed, uint8_t * array, size_t count)
+{
+    try
+    {
+        HuffmanExpander(compressed).read(array, count, false);
+    }
+    catch(EOFException &e)
+    {
+        throw LZ77FormatException();
+    }
+}
+
+/// the most a block can grow by : it would be stored
+constexpr size_t maxBlockGrowth = 5;
+
+size_t checkBlockSize(size_t blockSize)
+{
+    if(blockSize == 0 || blockSize > LZContainerFormat::maxBlockSize)
+        throw IOException("IO Error : invalid compression block size");
+    return blockSize;
+}
+}
+
+/// reads the blocks of the block format a few at a time and decompresses them in parallel
+class BlockExpander final
+{
+private:
+    shared_ptr<Reader> reader;
+    size_t maxBlockSize;
+    vector<uint8_t> decoded;
+    size_t decodedPosition = 0;
+    bool ended = false;
+    void readIndex()
+    {
+        uint32_t blockCount = reader->readU32();
+        for(uint32_t i = 0; i < blockCount; i++)
+        {
+            reader->readU32();
+            reader->readU32();
+        }
+        if(reader->readU32() != blockCount)
+            throw LZ77FormatException();
+        for(uint8_t magic : LZContainerFormat::blockIndexMagic)
+        {
+            if(reader->readByte() != magic)
+                throw LZ77FormatException();
+        }
+    }
+    /// read blocks until they hold at least wanted bytes or there is one for each thread, and decompress them
+    void expandBlocks(size_t wanted, size_t maxBlockCount)
+    {
+        vector<vector<uint8_t>> compressed;
+        vector<size_t> offsets(1, 0);
+        try
+        {
+            while(compressed.size() < maxBlockCount && offsets.back() < wanted)
+            {
+                size_t uncompressedSize = reader->readU32();
+                if(uncompressedSize == 0)
+                {
+                    readIndex();
+                    ended = true;
+                    break;
+                }
+                size_t compressedSize = reader->readU32();
+                if(uncompressedSize > maxBlockSize || compressedSize > uncompressedSize + maxBlockGrowth)
+                    throw LZ77FormatException();
+                compressed.push_back(vector<uint8_t>(compressedSize));
+                reader->readBytes(compressed.back().data(), compressedSize);
+                offsets.push_back(offsets.back() + uncompressedSize);
+            }
+        }
+        catch(EOFException &e)
+        {
+            throw LZ77FormatException();
+        }
+        decoded.resize(offsets.back());
+        decodedPosition = 0;
+        JobSystem::global().parallelFor(compressed.size(), [&](size_t index)
+        {
+            const vector<uint8_t> &block = compressed[index];
+            shared_ptr<const uint8_t> mem(block.data(), [](const uint8_t *) {});
+            expandBlock(make_shared<MemoryReader>(mem, block.size()), &decoded[offsets[index]], offsets[index + 1] - offsets[index]);
+        });
+    }
+public:
+    BlockExpander(shared_ptr<Reader> reader)
+        : reader(reader)
+    {
+        try
+        {
+            maxBlockSize = reader->readU32();
+        }
+        catch(EOFException &e)
+        {
+            throw LZ77FormatException();
+        }
+        if(maxBlockSize == 0 || maxBlockSize > LZContainerFormat::maxBlockSize)
+            throw LZ77FormatException();
+    }
+    /// read count bytes, or if partial is set stop once more would need another block
+    size_t read(uint8_t * array, size_t count, bool partial)
+    {
+        size_t retval = 0;
+        while(retval < count)
+        {
+            if(decodedPosition < decoded.size())
+            {
+                size_t copyCount = min(count - retval, decoded.size() - decodedPosition);
+                memcpy((void *)&array[retval], (const void *)&decoded[decodedPosition], copyCount);
+                decodedPosition += copyCount;
+                retval += copyCount;
+                continue;
+            }
+            if(partial && retval > 0)
+                break;
+            if(ended)
+                throw EOFException();
+            // more than one block could wait for input that hasn't been written yet
+            expandBlocks(count - retval, partial ? 1 : JobSystem::global().workerCount() + 1);
+        }
+        return retval;
+    }
+};
+
+BlockCompressWriter::BlockCompressWriter(shared_ptr<Writer> writer, size_t blockSize)
+    : writer(writer), blockSize(checkBlockSize(blockSize)), buffer(this->blockSize * (JobSystem::global().workerCount() + 1))
+{
+    writeWindow = &buffer[0];
+    writeWindowEnd = &buffer[0] + buffer.size();
+}
+
+BlockCompressWriter::~BlockCompressWriter()
+{
+    try
+    {
+        finish();
+    }
+    catch(IOException &e)
+    {
+    }
+}
+
+void BlockCompressWriter::compressBlocks()
+{
+    if(finished)
+        return;
+    size_t used = writeWindow - &buffer[0];
+    if(used == 0)
+        return;
+    size_t blockCount = (used + blockSize - 1) / blockSize;
+    vector<vector<uint8_t>> compressed(blockCount);
+    JobSystem::global().parallelFor(blockCount, [&](size_t index)
+    {
+        size_t start = index * blockSize, end = min(used, start + blockSize);
+        HuffmanEncoder().encodeBlock(&buffer[start], 0, end - start, compressed[index]);
+    });
+    vector<uint8_t> output;
+    if(!wroteHeader)
+    {
+        appendBlocksHeader(output, blockSize);
+        writer->writeBytes(output.data(), output.size());
+        wroteHeader = true;
+    }
+    for(size_t index = 0; index < blockCount; index++)
+    {
+        uint32_t uncompressedSize = min(used, (index + 1) * blockSize) - index * blockSize;
+        output.clear();
+        appendU32(output, uncompressedSize);
+        appendU32(output, compressed[index].size());
+        writer->writeBytes(output.data(), output.size());
+        writer->writeBytes(compressed[index].data(), compressed[index].size());
+        blockIndex.push_back(make_pair(uncompressedSize, (uint32_t)compressed[index].size()));
+    }
+    writeWindow = &buffer[0];
+}
+
+void BlockCompressWriter::flush()
+{
+    if(finished) // finish already wrote and flushed everything
+        return;
+    compressBlocks();
+    writer->flush();
+}
+
+void BlockCompressWriter::writeByte(uint8_t v)
+{
+    if(finished)
+        throw IOException("IO Error : write after finishing compression");
+    if(writeWindow == writeWindowEnd)
+        compressBlocks();
+    *writeWindow++ = v;
+}
+
+void BlockCompressWriter::writeBytes(const uint8_t * array, size_t count)
+{
+    if(finished && count > 0)
+        throw IOException("IO Error : write after finishing compression");
+    while(count > 0)
+    {
+        if(writeWindow == writeWindowEnd)
+            compressBlocks();
+        size_t copyCount = min(count, (size_t)(writeWindowEnd - writeWindow));
+        memcpy((void *)writeWindow, (const void *)array, copyCount);
+        writeWindow += copyCount;
+        array += copyCount;
+        count -= copyCount;
+    }
+}
+
+void BlockCompressWriter::finish()
+{
+    if(finished)
+        return;
+    compressBlocks();
+    finished = true;
+    writeWindow = writeWindowEnd = nullptr;
+    vector<uint8_t> output;
+    if(!wroteHeader)
+        appendBlocksHeader(output, blockSize);
+    appendU32(output, 0);
+    appendU32(output, blockIndex.size());
+    for(pair<uint32_t, uint32_t> block : blockIndex)
+    {
+        appendU32(output, block.first);
+        appendU32(output, block.second);
+    }
+    appendU32(output, blockIndex.size());
+    output.insert(output.end(), begin(LZContainerFormat::blockIndexMagic), end(LZContainerFormat::blockIndexMagic));
+    writer->writeBytes(output.data(), output.size());
+    writer->flush();
+}
+
+BlockCompressedData::BlockCompressedData(shared_ptr<MemoryReader> compressed)
+    : compressed(compressed)
+{
+    const uint8_t * data = compressed->data();
+    size_t size = compressed->size();
+    const size_t headerSize = 7, trailerSize = 4 + sizeof(LZContainerFormat::blockIndexMagic);
+    if(size < headerSize + 8 + trailerSize || data[0] != LZContainerFormat::magic0 || data[1] != LZContainerFormat::magic1
+            || data[2] != LZContainerFormat::blocksVersion
+            || !equal(begin(LZContainerFormat::blockIndexMagic), end(LZContainerFormat::blockIndexMagic), &data[size - sizeof(LZContainerFormat::blockIndexMagic)]))
+        throw LZ77FormatException();
+    size_t maxBlockSize = decodeU32(&data[3]);
+    if(maxBlockSize == 0 || maxBlockSize > LZContainerFormat::maxBlockSize)
+        throw LZ77FormatException();
+    size_t blockCount = decodeU32(&data[size - trailerSize]);
+    size_t indexSize = 8 + 8 * blockCount + trailerSize;
+    if(blockCount > (size - headerSize) / 8 || indexSize > size - headerSize)
+        throw LZ77FormatException();
+    size_t index = size - indexSize;
+    if(decodeU32(&data[index]) != 0 || decodeU32(&data[index + 4]) != blockCount)
+        throw LZ77FormatException();
+    size_t compressedOffset = headerSize;
+    for(size_t i = 0; i < blockCount; i++)
+    {
+        Block block;
+        block.uncompressedOffset = uncompressedSize;
+        block.uncompressedSize = decodeU32(&data[index + 8 + 8 * i]);
+        block.compressedSize = decodeU32(&data[index + 12 + 8 * i]);
+        block.compressedOffset = compressedOffset + 8;
+        if(block.uncompressedSize == 0 || block.uncompressedSize > maxBlockSize
+                || block.compressedSize > block.uncompressedSize + maxBlockGrowth)
+            throw LZ77FormatException();
+        compressedOffset = block.compressedOffset + block.compressedSize;
+        if(compressedOffset > index)
+            throw LZ77FormatException();
+        blocks.push_back(block);
+        uncompressedSize += block.uncompressedSize;
+    }
+    if(compressedOffset != index)
+        throw LZ77FormatException();
+}
+
+void BlockCompressedData::read(size_t offset, uint8_t * array, size_t count) const
+{
+    if(offset > uncompressedSize || count > uncompressedSize - offset)
+        throw EOFException();
+    if(count == 0)
+        return;
+    size_t firstBlock = upper_bound(blocks.begin(), blocks.end(), offset, [](size_t offset, const Block &block)
+    {
+        return offset < block.uncompressedOffset;
+    }) - blocks.begin() - 1;
+    size_t endBlock = firstBlock;
+    while(endBlock < blocks.size() && blocks[endBlock].uncompressedOffset < offset + count)
+        endBlock++;
+    JobSystem::global().parallelFor(endBlock - firstBlock, [&](size_t index)
+    {
+        const Block &block = blocks[firstBlock + index];
+        shared_ptr<MemoryReader> blockReader = compressed->slice(block.compressedOffset, block.compressedSize);
+        size_t start = max(offset, block.uncompressedOffset);
+        size_t end = min(offset + count, block.uncompressedOffset + block.uncompressedSize);
+        if(start == block.uncompressedOffset && end == block.uncompressedOffset + block.uncompressedSize)
+        {
+            expandBlock(blockReader, &array[start - offset], end - start);
+            return;
+        }
+        vector<uint8_t> decoded(block.uncompressedSize);
+        expandBlock(blockReader, decoded.data(), decoded.size());
+        memcpy((void *)&array[start - offset], (const void *)&decoded[start - block.uncompressedOffset], end - start);
+    });
+}
+
+constexpr size_t HuffmanExpander::windowMask, HuffmanExpander::maxTokenBits;
+constexpr unsigned HuffmanEncoder::hashBits;
+constexpr size_t HuffmanEncoder::windowMask, HuffmanEncoder::maxChainLength, HuffmanEncoder::niceLength;
+constexpr size_t HuffmanEncoder::maxLazyLength, HuffmanEncoder::tooFar;
+constexpr int32_t HuffmanEncoder::noPosition;
+constexpr uint8_t LZContainerFormat::magic0, LZContainerFormat::magic1, LZContainerFormat::huffmanVersion;
+constexpr uint8_t LZContainerFormat::blocksVersion, LZContainerFormat::blockIndexMagic[];
+constexpr size_t LZContainerFormat::windowSize, LZContainerFormat::defaultBlockSize, LZContainerFormat::maxBlockSize;
+constexpr size_t HuffmanCompressWriter::bufferSize;
+
+ExpandReader::ExpandReader(shared_ptr<Reader> reader)
+    : reader(reader)
+{
+}
+
+constexpr int LZ77CodeType::lengthBits, LZ77CodeType::offsetBits;
+constexpr size_t LZ77CodeType::maxLength, LZ77CodeType::maxOffset;
+constexpr size_t ExpandReader::bufferSize;
+constexpr size_t CompressWriter::windowSize, CompressWriter::maxMatchLength, CompressWriter::bufferSize;
+constexpr int CompressWriter::hashBits;
+constexpr size_t CompressWriter::hashSize, CompressWriter::maxChainLength, CompressWriter::noPosition, CompressWriter::outputSize;
+
+size_t ExpandReader::decodeLZ77(uint8_t * array, size_t count, bool partial)
+{
+    if(history.empty())
+        history.resize(LZContainerFormat::windowSize);
+    size_t retval = 0;
+    while(retval < count)
+    {
+        if(currentCode.eof())
+        {
+            if(partial && retval > 0)
+                break;
+            currentCode = LZ77CodeType::read(*reader);
+            continue;
+        }
+        if(historyEnd == history.size())
+        {
+            memmove((void *)&history[0], (const void *)&history[historyEnd - bufferSize], bufferSize);
+            historyEnd = bufferSize;
+        }
+        uint8_t * output = &history[historyEnd];
+        size_t outputCount;
+        if(currentCode.length == 0)
+        {
+            *output = currentCode.nextByte;
+            outputCount = 1;
+            currentCode = LZ77CodeType();
+        }
+        else
+        {
+            size_t distance = currentCode.offset + 1;
+            if(distance > historyEnd)
+                throw LZ77FormatException();
+            outputCount = min(min(currentCode.length, count - retval), history.size() - historyEnd);
+            const uint8_t * source = output - distance;
+            if(distance >= outputCount)
+                memcpy((void *)output, (const void *)source, outputCount);
+            else // the match overlaps what it writes so it repeats the last distance bytes
+            {
+                for(size_t i = 0; i < outputCount; i++)
+                    output[i] = source[i];
+            }
+            currentCode.length -= outputCount;
+            if(currentCode.length == 0)
+                currentCode = LZ77CodeType(currentCode.nextByte);
+        }
+        memcpy((void *)&array[retval], (const void *)output, outputCount);
+        historyEnd += outputCount;
+        retval += outputCount;
+    }
+    return retval;
+}
+
+ExpandReader::~ExpandReader()
+{
+}
+
+void ExpandReader::detectFormat()
+{
+    uint8_t first = reader->readByte(); // EOF here is an empty stream
+
+    try
+    {
+        uint8_t second = reader->readByte();
+        if(first == LZContainerFormat::magic0 && second == LZContainerFormat::magic1)
+        {
+            uint8_t version = reader->readByte();
+            if(version == LZContainerFormat::huffmanVersion)
+            {
+                huffmanExpander = unique_ptr<HuffmanExpander>(new HuffmanExpander(reader));
+                format = Format::Huffman;
+            }
+            else if(version == LZContainerFormat::blocksVersion)
+            {
+                blockExpander = unique_ptr<BlockExpander>(new BlockExpander(reader));
+                format = Format::Blocks;
+            }
+            else
+                throw LZ77FormatException();
+            return;
+        }
+        uint16_t v = (uint16_t)second << 8 | reader->readByte();
+        currentCode = LZ77CodeType(v >> LZ77CodeType::offsetBits, v & LZ77CodeType::maxOffset, first);
+        format = Format::LZ77;
+    }
+    catch(EOFException &e)
+    {
+        throw LZ77FormatException();
+    }
+}
+
+void ExpandReader::readBytes(uint8_t * array, size_t count)
+{
+    if(count == 0)
+        return;
+    if(format == Format::Unknown)
+        detectFormat();
+    if(format == Format::Huffman)
+    {
+        huffmanExpander->read(array, count, false);
+        return;
+    }
+    if(format == Format::Blocks)
+    {
+        blockExpander->read(array, count, false);
+        return;
+    }
+    decodeLZ77(array, count, false);
+}
+
+size_t ExpandReader::readUpTo(uint8_t * array, size_t count)
+{
+    if(count == 0)
+        return 0;
+    if(format == Format::Unknown)
+        detectFormat();
+    if(format == Format::Huffman)
+        return huffmanExpander->read(array, count, true);
+    if(format == Format::Blocks)
+        return blockExpander->read(array, count, true);
+    return decodeLZ77(array, count, true);
+}
+
+HuffmanCompressWriter::HuffmanCompressWriter(shared_ptr<Writer> writer)
+    : writer(writer), encoder(new HuffmanEncoder), buffer(bufferSize)
+{
+    writeWindow = &buffer[0];
+    writeWindowEnd = &buffer[0] + bufferSize;
+}
+
+HuffmanCompressWriter::~HuffmanCompressWriter()
+{
+    try
+    {
+        compressBlock();
+    }
+    catch(IOException &e)
+    {
+    }
+}
+
+void HuffmanCompressWriter::compressBlock()
+{
+    size_t used = writeWindow - &buffer[0];
+    if(used == historyLength)
+        return;
+    if(!wroteHeader)
+    {
+        const uint8_t header[3] = {LZContainerFormat::magic0, LZContainerFormat::magic1, LZContainerFormat::huffmanVersion};
+        output.insert(output.end(), begin(header), end(header));
+        wroteHeader = true;
+    }
+    encoder->encodeBlock(&buffer[0], historyLength, used, output);
+    historyLength = used;
+    if(used == bufferSize)
+    {
+        memmove((void *)&buffer[0], (const void *)&buffer[LZContainerFormat::windowSize], bufferSize - LZContainerFormat::windowSize);
+        encoder->slide();
+        historyLength -= LZContainerFormat::windowSize;
+        writeWindow -= LZContainerFormat::windowSize;
+    }
+    writer->writeBytes(output.data(), output.size());
+    output.clear();
+}
+
+void HuffmanCompressWriter::flush()
+{
+    compressBlock();
+    writer->flush();
+}
+
+void HuffmanCompressWriter::writeByte(uint8_t v)
+{
+    if(writeWindow == writeWindowEnd)
+        compressBlock();
+    *writeWindow++ = v;
+}
+
+void HuffmanCompressWriter::writeBytes(const uint8_t * array, size_t count)
+{
+    while(count > 0)
+    {
+        if(writeWindow == writeWindowEnd)
+            compressBlock();
+        size_t copyCount = min(count, (size_t)(writeWindowEnd - writeWindow));
+        memcpy((void *)writeWindow, (const void *)array, copyCount);
+        writeWindow += copyCount;
+        array += copyCount;
+        count -= copyCount;
+    }
+}
 
 #if 0 // use demo code
 namespace
@@ -33,6 +1365,45 @@ public:
     }
 };
 
+/// compress bytes with CompressWriterType, check they expand to the same bytes and that reading past the end throws EOFException
+template <typename CompressWriterType>
+void checkRoundTrip(const char * name, const vector<uint8_t> &bytes)
+{
+    MemoryWriter compressed;
+    {
+        CompressWriterType w(compressed);
+        w.writeBytes(bytes.data(), bytes.size());
+        w.flush();
+    }
+    ExpandReader reader(compressed.reader());
+    vector<uint8_t> expanded(bytes.size());
+    reader.readBytes(expanded.data(), expanded.size());
+    bool good = expanded == bytes;
+    for(size_t extra : {(size_t)1, (size_t)10})
+    {
+        vector<uint8_t> buffer(extra);
+        try
+        {
+            reader.readBytes(buffer.data(), buffer.size());
+            good = false;
+        }
+        catch(EOFException &e)
+        {
+        }
+    }
+    ExpandReader reader2(compressed.reader());
+    expanded.resize(bytes.size() + 10);
+    try
+    {
+        reader2.readBytes(expanded.data(), expanded.size());
+        good = false;
+    }
+    catch(EOFException &e)
+    {
+    }
+    cout << name << " round trip : " << (good ? "passed" : "FAILED") << " : " << bytes.size() << " -> " << compressed.size() << " bytes\n";
+}
+
 void dumpRead(shared_ptr<Reader> preader)
 {
     ExpandReader reader(preader);
@@ -52,6 +1423,13 @@ void dumpRead(shared_ptr<Reader> preader)
 
 initializer init1([]()
 {
+    vector<uint8_t> bytes;
+    for(size_t i = 0; i < 100000; i++)
+        bytes.push_back(i % 1000 < 100 ? rand() : "abcdefg 0123 "[i % 13]);
+    checkRoundTrip<CompressWriter>("LZ77", bytes);
+    checkRoundTrip<HuffmanCompressWriter>("Huffman", bytes);
+    checkRoundTrip<BlockCompressWriter>("blocks", bytes);
+    checkRoundTrip<BlockCompressWriter>("short blocks", vector<uint8_t>(bytes.begin(), bytes.begin() + 10));
     cout << "test compression :\n";
     thread readerThread;
     {
@@ -19,6 +19,8 @@
 #define COMPRESSED_STREAM_H_INCLUDED
 
 #include <deque>
+#include <algorithm>
+#include <iterator>
 #include "stream.h"
 #include <iostream>
 
@@ -61,7 +63,7 @@ struct LZ77CodeType final
     static LZ77CodeType read(Reader &reader)
     {
         LZ77CodeType retval;
-        retval.nextByte = reader.readByte();
+        retval.nextByte = reader.readU8();
 
         try
         {
@@ -79,206 +81,236 @@ struct LZ77CodeType final
     void write(Writer &writer)
     {
         //cout << "Write code : 0x" << hex << (unsigned)nextByte << dec << " : length : " << length << " : offset : " << offset << endl;
-        writer.writeByte(nextByte);
         uint16_t v = (offset & maxOffset) | (length << offsetBits);
-        writer.writeU16(v);
+        const uint8_t bytes[3] = {nextByte, (uint8_t)(v >> 8), (uint8_t)(v & 0xFF)};
+        writer.writeBytes(bytes, sizeof(bytes));
     }
 };
 
+/** the versioned container : two magic bytes and a version byte, then the data in that version's format.
+ * streams without the magic bytes are the original LZ77 format, whose first code can't start with them
+ * because its length would refer to bytes before the start of the stream
+ */
+struct LZContainerFormat final
+{
+    static constexpr uint8_t magic0 = 'L', magic1 = 'Z';
+    /// LZ77 with a 64 KiB window, in Huffman coded or stored blocks
+    static constexpr uint8_t huffmanVersion = 1;
+    /** independently compressed blocks in version 1's format so they can be compressed and decompressed in parallel.
+     * after the version byte is the big endian 32 bit maximum block size, then each block's uncompressed size,
+     * compressed size and data. an uncompressed size of 0 ends the blocks and is followed by the block index :
+     * the block count, each block's uncompressed and compressed sizes, the block count again and blockIndexMagic
+     */
+    static constexpr uint8_t blocksVersion = 2;
+    static constexpr size_t windowSize = (size_t)1 << 16;
+    static constexpr size_t defaultBlockSize = (size_t)1 << 18;
+    /// larger blocks are a format error so bad data can't make the reader allocate huge buffers
+    static constexpr size_t maxBlockSize = (size_t)1 << 24;
+    static constexpr uint8_t blockIndexMagic[4] = {'L', 'Z', 'I', 'X'};
+};
+
+class HuffmanExpander;
+class HuffmanEncoder;
+class BlockExpander;
+
+/// decompresses both the original LZ77 format and the versioned container, detected from the first bytes
 class ExpandReader final : public Reader
 {
 private:
+    enum class Format
+    {
+        Unknown,
+        LZ77,
+        Huffman,
+        Blocks
+    };
     shared_ptr<Reader> reader;
+    Format format = Format::Unknown;
+    unique_ptr<HuffmanExpander> huffmanExpander;
+    unique_ptr<BlockExpander> blockExpander;
     static constexpr size_t bufferSize = LZ77CodeType::maxOffset + 1;
-    circularDeque<uint8_t, bufferSize + 2> buffer;
+    /// the original format's decoded bytes, in order. once it fills up the last bufferSize bytes are moved to the start
+    vector<uint8_t> history;
+    size_t historyEnd = 0;
     LZ77CodeType currentCode;
+    void detectFormat();
+    /// decode the original format into array, stopping at the end of a code if partial is set and it decoded something
+    size_t decodeLZ77(uint8_t * array, size_t count, bool partial);
 public:
-    ExpandReader(shared_ptr<Reader> reader)
-        : reader(reader)
-    {
-    }
+    ExpandReader(shared_ptr<Reader> reader);
     ExpandReader(Reader &reader)
         : ExpandReader(shared_ptr<Reader>(&reader, [](Reader *) {}))
     {
     }
-    virtual ~ExpandReader()
-    {
-    }
+    virtual ~ExpandReader();
     virtual uint8_t readByte() override
     {
-        while(currentCode.eof())
-        {
-            currentCode = LZ77CodeType::read(*reader);
-        }
-
         uint8_t retval;
-
-        if(currentCode.length == 0)
-        {
-            retval = currentCode.nextByte;
-            currentCode = LZ77CodeType();
-        }
-        else
-        {
-            if(currentCode.offset >= buffer.size())
-            {
-                throw LZ77FormatException();
-            }
-
-            retval = buffer.cbegin()[currentCode.offset];
-
-            if(--currentCode.length == 0)
-            {
-                currentCode = LZ77CodeType(currentCode.nextByte);
-            }
-        }
-
-        buffer.push_front(retval);
-
-        if(buffer.size() > bufferSize)
-        {
-            buffer.pop_back();
-        }
-
+        readBytes(&retval, 1);
         return retval;
     }
+    virtual void readBytes(uint8_t * array, size_t count) override;
+    /// decodes what it can without waiting for more input than it needs
+    virtual size_t readUpTo(uint8_t * array, size_t count) override;
 };
 
+/** LZ77 compressor. matches are found with hash chains of 3 byte prefixes, with the most recent
+ * 2 byte and 1 byte prefixes as fallbacks because even a 1 byte match saves a code in this format
+ */
 class CompressWriter final : public Writer
 {
 private:
-    static constexpr int uint8_max = (1 << 8) - 1;
-    static constexpr size_t bufferSize = LZ77CodeType::maxOffset + 1;
-    struct Match
-    {
-        size_t location, length;
-        Match(size_t location, size_t length)
-            : location(location), length(length)
-        {
-        }
-        Match()
-            : Match(0, 0)
-        {
-        }
-    };
-
-    size_t location;
-    size_t getActualLocation(size_t l)
-    {
-        return location - l;
-    }
+    static constexpr size_t windowSize = LZ77CodeType::maxOffset + 1;
+    static constexpr size_t maxMatchLength = LZ77CodeType::maxLength;
+    static constexpr size_t bufferSize = 1 << 15;
+    static constexpr int hashBits = 12;
+    static constexpr size_t hashSize = (size_t)1 << hashBits;
+    static constexpr size_t maxChainLength = 64;
+    static constexpr size_t noPosition = ~(size_t)0;
+    static constexpr size_t outputSize = 3 * 1024;
+    static_assert(bufferSize >= 2 * windowSize + maxMatchLength + 1, "bufferSize is too small");
 
     shared_ptr<Writer> writer;
-    circularDeque<uint_fast8_t, bufferSize + 1> currentInput;
-    circularDeque<uint_fast8_t, bufferSize + 2> buffer;
-    list<size_t> nodes[uint8_max + 1];
+    /// the input from absolute position bufferStart : the window behind position, then the input that isn't encoded yet
+    uint8_t buffer[bufferSize];
+    size_t bufferStart = 0, position = 0, inputEnd = 0;
+    /// every position before insertPosition is in the hash tables
+    size_t insertPosition = 0;
+    size_t head3[hashSize], head2[hashSize], head1[256];
+    /// the previous position with the same 3 byte hash, indexed by position % windowSize
+    size_t prev3[windowSize];
+    uint8_t output[outputSize];
+    size_t outputUsed = 0;
 
-    void addByte(uint_fast8_t v)
+    const uint8_t * at(size_t absolutePosition) const
+    {
+        return &buffer[absolutePosition - bufferStart];
+    }
+    static size_t hash3(const uint8_t * p)
+    {
+        return (((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761U) >> (32 - hashBits);
+    }
+    static size_t hash2(const uint8_t * p)
     {
-        nodes[v].push_front(++location);
-        buffer.push_front(v);
-        if(buffer.size() > bufferSize)
+        return (((uint32_t)p[0] << 8 | p[1]) * 2654435761U) >> (32 - hashBits);
+    }
+    bool inWindow(size_t candidate) const
+    {
+        return candidate != noPosition && candidate < position && position - candidate <= windowSize;
+    }
+    void insertPositions()
+    {
+        for(; insertPosition < position && insertPosition + 3 <= inputEnd; insertPosition++)
         {
-            buffer.pop_back();
-            for(list<size_t> & nodeList : nodes)
-            {
-                for(auto i = nodeList.begin(); i != nodeList.end();)
-                {
-                    if(getActualLocation(*i) >= buffer.size())
-                        i = nodeList.erase(i);
-                    else
-                        i++;
-                }
-            }
+            const uint8_t * p = at(insertPosition);
+            size_t & head = head3[hash3(p)];
+            prev3[insertPosition % windowSize] = head;
+            head = insertPosition;
+            head2[hash2(p)] = insertPosition;
+            head1[p[0]] = insertPosition;
         }
     }
-
-    /*void dumpLocation(size_t l)
+    size_t matchLength(size_t candidate, size_t maxLength) const
+    {
+        const uint8_t * a = at(candidate), * b = at(position);
+        size_t length = 0;
+        while(length < maxLength && a[length] == b[length])
+            length++;
+        return length;
+    }
+    void findMatch(size_t maxLength, size_t & bestLength, size_t & bestDistance)
     {
-        cout << l << " : ";
-        l = getActualLocation(l);
-        if(l >= buffer.size())
-            cout << "\"\"" << endl;
-        else
+        bestLength = 0;
+        bestDistance = 0;
+        if(maxLength == 0)
+            return;
+        const uint8_t * p = at(position);
+        if(maxLength >= 3)
         {
-            cout << "\"";
-            auto iter = buffer.cbegin() + l;
-            for(int i = 0; i < 5 && i <= l; i++, iter--)
+            size_t candidate = head3[hash3(p)];
+            for(size_t chain = 0; chain < maxChainLength && inWindow(candidate); chain++)
             {
-                cout << (char)*iter;
+                size_t length = matchLength(candidate, maxLength);
+                if(length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = position - candidate;
+                    if(length == maxLength)
+                        break;
+                }
+                size_t next = prev3[candidate % windowSize];
+                if(next >= candidate)
+                    break;
+                candidate = next;
             }
-            cout << "\"" << endl;
+            if(bestLength >= 3)
+                return;
         }
-    }*/
-
-    Match getBiggestMatch()
-    {
-        Match retval;
-        auto ii = currentInput.cbegin();
-        if(ii == currentInput.cend())
-            return Match();
-        const list<size_t> & curNodes = nodes[*ii++];
-        if(curNodes.empty())
-            return Match();
-        auto startII = ii;
-        for(size_t startPos : curNodes)
+        size_t shortCandidates[2] = {(maxLength >= 2 ? head2[hash2(p)] : noPosition), head1[p[0]]};
+        for(size_t candidate : shortCandidates)
         {
-            size_t matchLength = 1;
-            size_t node = startPos;
-            for(ii = startII; ii != currentInput.cend(); matchLength++, ii++, node++)
-            {
-                size_t pos = getActualLocation(node + 1);
-                if(pos >= buffer.size())
-                    break;
-                if(buffer.cbegin()[pos] != *ii)
-                    break;
-            }
-            if(matchLength > retval.length)
+            if(!inWindow(candidate))
+                continue;
+            size_t length = matchLength(candidate, maxLength);
+            if(length > bestLength)
             {
-                retval.length = matchLength;
-                retval.location = getActualLocation(startPos);
+                bestLength = length;
+                bestDistance = position - candidate;
             }
         }
-        if(retval.length > LZ77CodeType::maxLength + 1)
-            retval.length = LZ77CodeType::maxLength + 1;
-        return retval;
     }
-
-    void writeCode()
+    void writeCode(LZ77CodeType code)
     {
-        if(currentInput.empty())
-            return;
-        if(currentInput.size() == 1)
+        if(outputUsed + 3 > outputSize)
+            writeOutput();
+        uint16_t v = (code.offset & LZ77CodeType::maxOffset) | (code.length << LZ77CodeType::offsetBits);
+        output[outputUsed++] = code.nextByte;
+        output[outputUsed++] = (uint8_t)(v >> 8);
+        output[outputUsed++] = (uint8_t)(v & 0xFF);
+    }
+    void writeOutput()
+    {
+        if(outputUsed > 0)
+            writer->writeBytes(output, outputUsed);
+        outputUsed = 0;
+    }
+    /// encode the input up to the point where there is less than minLookahead bytes left
+    void encode(size_t minLookahead)
+    {
+        while(inputEnd - position > minLookahead)
         {
-            addByte(currentInput.front());
-            LZ77CodeType(currentInput.front()).write(*writer);
-            currentInput.pop_front();
-            return;
+            insertPositions();
+            size_t length, distance;
+            findMatch(min(maxMatchLength, inputEnd - position - 1), length, distance);
+            if(length == 0)
+                writeCode(LZ77CodeType(*at(position)));
+            else
+                writeCode(LZ77CodeType(length, distance - 1, *at(position + length)));
+            position += length + 1;
         }
-        Match m = getBiggestMatch();
-        if(m.length <= 1)
-        {
-            addByte(currentInput.front());
-            LZ77CodeType(currentInput.front()).write(*writer);
-            currentInput.pop_front();
+    }
+    /// make room at the end of the buffer by dropping input that is out of the window
+    void compact()
+    {
+        size_t newStart = max(bufferStart, min(position, insertPosition) > windowSize ? min(position, insertPosition) - windowSize : 0);
+        if(newStart == bufferStart)
             return;
-        }
-        m.length--;
-        for(size_t i = 0; i < m.length; i++)
-        {
-            addByte(currentInput.front());
-            currentInput.pop_front();
-        }
-        LZ77CodeType code(m.length, m.location, currentInput.front());
-        code.write(*writer);
-        addByte(currentInput.front());
-        currentInput.pop_front();
+        memmove((void *)buffer, (const void *)at(newStart), inputEnd - newStart);
+        bufferStart = newStart;
+    }
+    size_t bufferSpace() const
+    {
+        return bufferSize - (inputEnd - bufferStart);
     }
 
 public:
     CompressWriter(shared_ptr<Writer> writer)
         : writer(writer)
     {
+        fill(begin(head3), end(head3), noPosition);
+        fill(begin(head2), end(head2), noPosition);
+        fill(begin(head1), end(head1), noPosition);
+        fill(begin(prev3), end(prev3), noPosition);
     }
     CompressWriter(Writer &writer)
         : CompressWriter(shared_ptr<Writer>(&writer, [](Writer *) {}))
@@ -289,17 +321,116 @@ public:
     }
     virtual void flush() override
     {
-        while(!currentInput.empty())
-            writeCode();
+        encode(0);
+        writeOutput();
         writer->flush();
     }
     virtual void writeByte(uint8_t v) override
     {
-        currentInput.push_back(v);
-        if(currentInput.size() < bufferSize)
-            return;
-        writeCode();
+        writeBytes(&v, 1);
+    }
+    virtual void writeBytes(const uint8_t * array, size_t count) override
+    {
+        while(count > 0)
+        {
+            if(bufferSpace() == 0)
+            {
+                encode(maxMatchLength);
+                compact();
+            }
+            size_t copyCount = min(count, bufferSpace());
+            memcpy((void *)&buffer[inputEnd - bufferStart], (const void *)array, copyCount);
+            inputEnd += copyCount;
+            array += copyCount;
+            count -= copyCount;
+        }
+    }
+};
+
+/** compresses into the versioned container's Huffman format : LZ77 with a 64 KiB window
+ * and up to 258 byte matches, with Huffman coded literals, lengths and distances.
+ * input is compressed a block at a time and on flush, so flush often makes the output worse
+ */
+class HuffmanCompressWriter final : public Writer
+{
+private:
+    static constexpr size_t bufferSize = 2 * LZContainerFormat::windowSize;
+    shared_ptr<Writer> writer;
+    unique_ptr<HuffmanEncoder> encoder;
+    /// the window, then the input that isn't compressed yet up to writeWindow
+    vector<uint8_t> buffer;
+    size_t historyLength = 0;
+    vector<uint8_t> output;
+    bool wroteHeader = false;
+    void compressBlock();
+public:
+    HuffmanCompressWriter(shared_ptr<Writer> writer);
+    HuffmanCompressWriter(Writer &writer)
+        : HuffmanCompressWriter(shared_ptr<Writer>(&writer, [](Writer *) {}))
+    {
+    }
+    virtual ~HuffmanCompressWriter();
+    virtual void flush() override;
+    virtual void writeByte(uint8_t v) override;
+    virtual void writeBytes(const uint8_t * array, size_t count) override;
+};
+
+/** compresses into the versioned container's block format. input is split into blocks that are
+ * compressed on the global JobSystem, several at a time, and the block index is written by finish
+ * or the destructor. flush ends the current block early, and writing after finish throws IOException
+ */
+class BlockCompressWriter final : public Writer
+{
+private:
+    shared_ptr<Writer> writer;
+    size_t blockSize;
+    /// the blocks that are compressed together, filled up to writeWindow
+    vector<uint8_t> buffer;
+    /// the uncompressed and compressed size of each block written
+    vector<pair<uint32_t, uint32_t>> blockIndex;
+    bool wroteHeader = false, finished = false;
+    void compressBlocks();
+public:
+    BlockCompressWriter(shared_ptr<Writer> writer, size_t blockSize = LZContainerFormat::defaultBlockSize);
+    BlockCompressWriter(Writer &writer, size_t blockSize = LZContainerFormat::defaultBlockSize)
+        : BlockCompressWriter(shared_ptr<Writer>(&writer, [](Writer *) {}), blockSize)
+    {
+    }
+    virtual ~BlockCompressWriter();
+    virtual void flush() override;
+    virtual void writeByte(uint8_t v) override;
+    virtual void writeBytes(const uint8_t * array, size_t count) override;
+    /// compress what's left and write the block index. nothing can be written after this
+    void finish();
+};
+
+/** random access into a stream written by BlockCompressWriter that is in memory,
+ * using the block index at its end
+ */
+class BlockCompressedData final
+{
+private:
+    struct Block final
+    {
+        size_t uncompressedOffset, uncompressedSize;
+        size_t compressedOffset, compressedSize;
+    };
+    shared_ptr<MemoryReader> compressed;
+    vector<Block> blocks;
+    size_t uncompressedSize = 0;
+public:
+    explicit BlockCompressedData(shared_ptr<MemoryReader> compressed);
+    /// @return the uncompressed size
+    size_t size() const
+    {
+        return uncompressedSize;
+    }
+    size_t blockCount() const
+    {
+        return blocks.size();
     }
+    /// decompress count bytes starting at offset, decompressing the blocks in parallel
+    void read(size_t offset, uint8_t * array, size_t count) const;
 };
 
 #endif // COMPRESSED_STREAM_H_INCLUDED
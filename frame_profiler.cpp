@@ -0,0 +1,204 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "frame_profiler.h"
+#include "text.h"
+#include "util.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+FrameProfiler::FrameProfiler()
+    : framesWritten(0), creationTime(chrono::steady_clock::now()), lastFrameEnd(creationTime)
+{
+    for(Slot &slot : slots)
+    {
+        slot.sequence.store(0, memory_order_relaxed);
+        for(atomic<double> &value : slot.values)
+            value.store(0, memory_order_relaxed);
+    }
+    for(atomic<int64_t> &time : stageTimes)
+        time.store(0, memory_order_relaxed);
+}
+
+FrameProfiler &FrameProfiler::global()
+{
+    static FrameProfiler retval;
+    return retval;
+}
+
+const wchar_t *FrameProfiler::stageName(Stage stage)
+{
+    switch(stage)
+    {
+    case Events:
+        return L"events";
+    case Physics:
+        return L"physics";
+    case MeshBuild:
+        return L"mesh build";
+    case Submit:
+        return L"submit";
+    case Swap:
+        return L"swap";
+    case StageCount:
+        break;
+    }
+    assert(false);
+    return L"";
+}
+
+Color FrameProfiler::stageColor(Stage stage)
+{
+    switch(stage)
+    {
+    case Events:
+        return Color(1, 1, 0);
+    case Physics:
+        return Color(0.25, 0.5, 1);
+    case MeshBuild:
+        return Color(0, 1, 0);
+    case Submit:
+        return Color(1, 0, 1);
+    case Swap:
+        return Color(0.6);
+    case StageCount:
+        break;
+    }
+    assert(false);
+    return Color(1);
+}
+
+void FrameProfiler::endFrame()
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    size_t number = framesWritten.load(memory_order_relaxed);
+    Slot &slot = slots[number % historySize];
+    slot.sequence.store(2 * number + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.values[0].store(chrono::duration<double>(lastFrameEnd - creationTime).count(), memory_order_relaxed);
+    slot.values[1].store(chrono::duration<double>(now - lastFrameEnd).count(), memory_order_relaxed);
+    for(size_t i = 0; i < StageCount; i++)
+    {
+        int64_t nanoseconds = stageTimes[i].exchange(0, memory_order_relaxed);
+        slot.values[i + 2].store(1e-9 * nanoseconds, memory_order_relaxed);
+    }
+    slot.sequence.store(2 * number + 2, memory_order_release);
+    framesWritten.store(number + 1, memory_order_release);
+    lastFrameEnd = now;
+}
+
+bool FrameProfiler::getFrame(size_t number, Frame &frame) const
+{
+    const Slot &slot = slots[number % historySize];
+    size_t sequence = slot.sequence.load(memory_order_acquire);
+    if(sequence != 2 * number + 2)
+        return false;
+    double values[valueCount];
+    for(size_t i = 0; i < valueCount; i++)
+        values[i] = slot.values[i].load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if(slot.sequence.load(memory_order_relaxed) != sequence)
+        return false;
+    frame.number = number;
+    frame.startTime = values[0];
+    frame.duration = values[1];
+    for(size_t i = 0; i < StageCount; i++)
+        frame.stageTimes[i] = values[i + 2];
+    return true;
+}
+
+vector<FrameProfiler::Frame> FrameProfiler::history(size_t maxFrames) const
+{
+    size_t endFrame = frameCount();
+    maxFrames = min(maxFrames, historySize);
+    size_t startFrame = (endFrame > maxFrames ? endFrame - maxFrames : 0);
+    vector<Frame> retval;
+    retval.reserve(endFrame - startFrame);
+    Frame frame;
+    for(size_t number = startFrame; number < endFrame; number++)
+    {
+        if(getFrame(number, frame))
+            retval.push_back(frame);
+    }
+    return retval;
+}
+
+size_t FrameProfiler::writeCSV(ostream &os, size_t firstFrame) const
+{
+    if(firstFrame == 0)
+    {
+        os << "frame,start (ms),duration (ms)";
+        for(size_t i = 0; i < StageCount; i++)
+            os << "," << wcsrtombs(stageName(static_cast<Stage>(i))) << " (ms)";
+        os << "\n";
+    }
+    size_t endFrame = frameCount();
+    if(endFrame > historySize && firstFrame < endFrame - historySize)
+        firstFrame = endFrame - historySize;
+    Frame frame;
+    for(size_t number = firstFrame; number < endFrame; number++)
+    {
+        if(!getFrame(number, frame))
+            continue;
+        os << frame.number << "," << 1000 * frame.startTime << "," << 1000 * frame.duration;
+        for(double time : frame.stageTimes)
+            os << "," << 1000 * time;
+        os << "\n";
+    }
+    return endFrame;
+}
+
+Mesh FrameProfiler::graphMesh(size_t frameCount, float maxTime) const
+{
+    Mesh retval = Mesh(new Mesh_t());
+    if(frameCount == 0 || maxTime <= 0)
+        return retval;
+    vector<Frame> frames = history(frameCount);
+    const float columnWidth = 1.0f / frameCount;
+    const float xOffset = columnWidth * (frameCount - frames.size());
+    Mesh blocks[StageCount];
+    for(size_t i = 0; i < StageCount; i++)
+        blocks[i] = Text::mesh(L"\u2588", stageColor(static_cast<Stage>(i)));
+    for(size_t column = 0; column < frames.size(); column++)
+    {
+        float bottom = 0;
+        for(size_t i = 0; i < StageCount && bottom < 1; i++)
+        {
+            float top = min(1.0f, bottom + static_cast<float>(frames[column].stageTimes[i] / maxTime));
+            if(top > bottom)
+                retval->add(transform(Matrix::scale(columnWidth, top - bottom, 1).concat(Matrix::translate(xOffset + columnWidth * column, bottom, 0)), blocks[i]));
+            bottom = top;
+        }
+    }
+    const float lineHeight = 1.0f / (StageCount + 1);
+    const float textScale = lineHeight * 0.8f;
+    for(size_t i = 0; i < StageCount; i++)
+    {
+        float y = 1 - lineHeight * (i + 1);
+        retval->add(transform(Matrix::scale(textScale).concat(Matrix::translate(1 + textScale, y, 0)), Text::mesh(stageName(static_cast<Stage>(i)), stageColor(static_cast<Stage>(i)))));
+    }
+    if(!frames.empty())
+    {
+        wostringstream ss;
+        ss << fixed << setprecision(1) << 1000 * frames.back().duration << L" ms";
+        retval->add(transform(Matrix::scale(textScale).concat(Matrix::translate(1 + textScale, 0, 0)), Text::mesh(ss.str())));
+    }
+    return retval;
+}
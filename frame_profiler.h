@@ -0,0 +1,125 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef FRAME_PROFILER_H_INCLUDED
+#define FRAME_PROFILER_H_INCLUDED
+
+#include "mesh.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+/** per-frame CPU time of the main loop stages.
+ * times can be added from any thread and the finished frames are kept in a ring buffer
+ * that can be read while frames are being written without taking any locks.
+ */
+class FrameProfiler final
+{
+public:
+    enum Stage
+    {
+        Events,
+        /// time the physics thread spent stepping during the frame. it runs alongside the main loop so it isn't part of the frame's duration
+        Physics,
+        MeshBuild,
+        Submit,
+        Swap,
+        StageCount
+    };
+    static const size_t historySize = 512;
+    struct Frame
+    {
+        size_t number = 0;
+        /// seconds since the profiler was created
+        double startTime = 0;
+        /// wall time from the end of the previous frame to the end of this one
+        double duration = 0;
+        double stageTimes[StageCount] = {};
+    };
+    /// times the stage for as long as the scope lives
+    class Scope final
+    {
+    private:
+        FrameProfiler &profiler;
+        Stage stage;
+        chrono::steady_clock::time_point startTime;
+        Scope(const Scope &) = delete;
+        const Scope &operator =(const Scope &) = delete;
+    public:
+        explicit Scope(Stage stage, FrameProfiler &profiler = FrameProfiler::global())
+            : profiler(profiler), stage(stage), startTime(chrono::steady_clock::now())
+        {
+        }
+        ~Scope()
+        {
+            profiler.addTime(stage, chrono::steady_clock::now() - startTime);
+        }
+    };
+    FrameProfiler();
+    static FrameProfiler &global();
+    static const wchar_t *stageName(Stage stage);
+    static Color stageColor(Stage stage);
+    /// add time to the current frame. wait-free and callable from any thread
+    void addTime(Stage stage, chrono::steady_clock::duration time)
+    {
+        stageTimes[stage].fetch_add(static_cast<int64_t>(chrono::duration_cast<chrono::nanoseconds>(time).count()), memory_order_relaxed);
+    }
+    /// finish the current frame. must only be called from one thread
+    void endFrame();
+    /// @return the number of finished frames
+    size_t frameCount() const
+    {
+        return framesWritten.load(memory_order_acquire);
+    }
+    /** @param number the frame to get
+     * @param frame set to the frame
+     * @return false if the frame isn't finished yet or was already overwritten
+     */
+    bool getFrame(size_t number, Frame &frame) const;
+    /// @return the last maxFrames finished frames that are still in the history, oldest first
+    vector<Frame> history(size_t maxFrames = historySize) const;
+    /** write the frames from firstFrame on that are still in the history as CSV, times in milliseconds.
+     * the header is only written when firstFrame is 0.
+     *
+     * @return the frame to pass as firstFrame on the next call
+     */
+    size_t writeCSV(ostream &os, size_t firstFrame = 0) const;
+    /** make a stacked bar graph of the last frameCount frames in the unit square with a legend above it.
+     * a bar reaching the top means the frame took maxTime seconds
+     */
+    Mesh graphMesh(size_t frameCount = 120, float maxTime = 1 / 30.0f) const;
+private:
+    static const size_t valueCount = StageCount + 2;
+    /// seqlock : sequence is odd while the slot is being written and 2 * number + 2 after frame number is written
+    struct Slot
+    {
+        atomic_size_t sequence;
+        atomic<double> values[valueCount];
+    };
+    Slot slots[historySize];
+    atomic<int64_t> stageTimes[StageCount];
+    atomic_size_t framesWritten;
+    chrono::steady_clock::time_point creationTime, lastFrameEnd;
+    FrameProfiler(const FrameProfiler &) = delete;
+    const FrameProfiler &operator =(const FrameProfiler &) = delete;
+};
+
+#endif // FRAME_PROFILER_H_INCLUDED
@@ -0,0 +1,52 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "frustum.h"
+#include "platform.h"
+
+Frustum::Frustum(const float projection[16], const float modelview[16])
+{
+    float m[16]; // projection * modelview, column-major
+    for(int column = 0; column < 4; column++)
+    {
+        for(int row = 0; row < 4; row++)
+        {
+            float sum = 0;
+            for(int i = 0; i < 4; i++)
+            {
+                sum += projection[i * 4 + row] * modelview[column * 4 + i];
+            }
+            m[column * 4 + row] = sum;
+        }
+    }
+    // a point is inside if -w <= x, y, z <= w in clip coordinates, so each plane is the w row plus or minus another row
+    for(int i = 0; i < 6; i++)
+    {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1 : -1;
+        planes[i].normal = VectorF(m[3] + sign * m[row], m[7] + sign * m[4 + row], m[11] + sign * m[8 + row]);
+        planes[i].d = m[15] + sign * m[12 + row];
+    }
+}
+
+Frustum Frustum::current()
+{
+    float projection[16], modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    return Frustum(projection, modelview);
+}
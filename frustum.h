@@ -0,0 +1,71 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef FRUSTUM_H_INCLUDED
+#define FRUSTUM_H_INCLUDED
+
+#include "mesh.h"
+
+/** the volume that can be seen, as 6 planes.
+ * the planes are in the coordinates that are passed to OpenGL, so a box is visible if it's on the inside of every plane.
+ */
+class Frustum final
+{
+private:
+    struct Plane
+    {
+        VectorF normal;
+        float d;
+    };
+    Plane planes[6];
+public:
+    /** make a frustum from OpenGL's matrices
+     *
+     * @param projection the projection matrix in OpenGL's column-major order
+     * @param modelview the modelview matrix in OpenGL's column-major order
+     */
+    Frustum(const float projection[16], const float modelview[16]);
+    /// @return the frustum for the current GL_PROJECTION_MATRIX and GL_MODELVIEW_MATRIX
+    static Frustum current();
+    bool visible(const BoundingBox &box) const
+    {
+        if(box.empty())
+            return false;
+        VectorF center = box.center(), halfExtents = box.halfExtents();
+        for(const Plane &plane : planes)
+        {
+            float distance = dot(plane.normal, center) + plane.d;
+            float radius = abs(plane.normal.x) * halfExtents.x + abs(plane.normal.y) * halfExtents.y + abs(plane.normal.z) * halfExtents.z;
+            if(distance + radius < 0)
+                return false;
+        }
+        return true;
+    }
+    /// @return if any of mesh could be visible
+    bool visible(const TransformedMesh &mesh) const
+    {
+        if(mesh.mesh == nullptr)
+            return false;
+        return visible(transform(mesh.tform, mesh.mesh->bounds()));
+    }
+    bool visible(const Mesh_t &mesh) const
+    {
+        return visible(mesh.bounds());
+    }
+};
+
+#endif // FRUSTUM_H_INCLUDED
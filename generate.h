@@ -19,6 +19,7 @@
 #define GENERATE_H_INCLUDED
 
 #include "mesh.h"
+#include "indexed_mesh.h"
 #include <utility>
 
 inline Mesh invert(Mesh mesh)
@@ -121,6 +122,90 @@ namespace Generate
 		}
 		return retval;
 	}
+
+	/// make a quadrilateral with 4 shared vertices
+	inline IndexedMesh indexedQuadrilateral(TextureDescriptor texture, VectorF p1, Color c1, VectorF p2, Color c2, VectorF p3, Color c3, VectorF p4, Color c4)
+	{
+		IndexedMesh retval = IndexedMesh(new IndexedMesh_t(texture.image));
+		retval->reserve(4, 2);
+		size_t i1 = retval->addVertex(p1, c1, TextureCoord(texture.minU, texture.minV));
+		size_t i2 = retval->addVertex(p2, c2, TextureCoord(texture.maxU, texture.minV));
+		size_t i3 = retval->addVertex(p3, c3, TextureCoord(texture.maxU, texture.maxV));
+		size_t i4 = retval->addVertex(p4, c4, TextureCoord(texture.minU, texture.maxV));
+		retval->addTriangle(i1, i2, i3);
+		retval->addTriangle(i3, i4, i1);
+		return retval;
+	}
+
+	/// make an indexed box from <0, 0, 0> to <1, 1, 1> with 24 vertices instead of 36
+	inline IndexedMesh indexedUnitBox(TextureDescriptor nx, TextureDescriptor px, TextureDescriptor ny, TextureDescriptor py, TextureDescriptor nz, TextureDescriptor pz)
+	{
+		const VectorF p0 = VectorF(0, 0, 0);
+		const VectorF p1 = VectorF(1, 0, 0);
+		const VectorF p2 = VectorF(0, 1, 0);
+		const VectorF p3 = VectorF(1, 1, 0);
+		const VectorF p4 = VectorF(0, 0, 1);
+		const VectorF p5 = VectorF(1, 0, 1);
+		const VectorF p6 = VectorF(0, 1, 1);
+		const VectorF p7 = VectorF(1, 1, 1);
+		IndexedMesh retval = IndexedMesh(new IndexedMesh_t());
+		const Color c = Color(1);
+		if(nx)
+		{
+			retval->add(indexedQuadrilateral(nx,
+									 p0, c,
+									 p4, c,
+									 p6, c,
+									 p2, c
+									 ));
+		}
+		if(px)
+		{
+			retval->add(indexedQuadrilateral(px,
+									 p5, c,
+									 p1, c,
+									 p3, c,
+									 p7, c
+									 ));
+		}
+		if(ny)
+		{
+			retval->add(indexedQuadrilateral(ny,
+									 p0, c,
+									 p1, c,
+									 p5, c,
+									 p4, c
+									 ));
+		}
+		if(py)
+		{
+			retval->add(indexedQuadrilateral(py,
+									 p6, c,
+									 p7, c,
+									 p3, c,
+									 p2, c
+									 ));
+		}
+		if(nz)
+		{
+			retval->add(indexedQuadrilateral(nz,
+									 p1, c,
+									 p0, c,
+									 p2, c,
+									 p3, c
+									 ));
+		}
+		if(pz)
+		{
+			retval->add(indexedQuadrilateral(pz,
+									 p4, c,
+									 p5, c,
+									 p7, c,
+									 p6, c
+									 ));
+		}
+		return retval;
+	}
 }
 
 #endif // GENERATE_H_INCLUDED
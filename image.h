@@ -77,6 +77,11 @@ public:
     {
         return l.data != r.data;
     }
+    /// an arbitrary but consistent order for sorting by image
+    friend bool operator <(Image l, Image r)
+    {
+        return l.data < r.data;
+    }
 private:
     enum RowOrder
     {
@@ -0,0 +1,58 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#define GL_GLEXT_PROTOTYPES
+#include "indexed_mesh.h"
+#include "platform.h"
+
+Renderer & operator <<(Renderer & renderer, const IndexedMesh_t & m)
+{
+    if(m.size() == 0)
+        return renderer;
+    m.texture().bind();
+    bool needsUpload;
+    bool fromBufferObject = m.bufferObject.bind(false, needsUpload);
+    size_t pointsSize = sizeof(float) * m.points.size();
+    size_t textureCoordsSize = sizeof(float) * m.textureCoords.size();
+    size_t colorsSize = sizeof(float) * m.colors.size();
+    if(needsUpload)
+    {
+        glBufferData(GL_ARRAY_BUFFER, pointsSize + textureCoordsSize + colorsSize, nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, pointsSize, (const void *)m.points.data());
+        glBufferSubData(GL_ARRAY_BUFFER, pointsSize, textureCoordsSize, (const void *)m.textureCoords.data());
+        glBufferSubData(GL_ARRAY_BUFFER, pointsSize + textureCoordsSize, colorsSize, (const void *)m.colors.data());
+    }
+    if(fromBufferObject)
+    {
+        glVertexPointer(3, GL_FLOAT, 0, (const void *)0);
+        glTexCoordPointer(2, GL_FLOAT, 0, (const void *)pointsSize);
+        glColorPointer(4, GL_FLOAT, 0, (const void *)(pointsSize + textureCoordsSize));
+    }
+    else
+    {
+        glVertexPointer(3, GL_FLOAT, 0, (const void *)m.points.data());
+        glTexCoordPointer(2, GL_FLOAT, 0, (const void *)m.textureCoords.data());
+        glColorPointer(4, GL_FLOAT, 0, (const void *)m.colors.data());
+    }
+    if(m.usesLongIndices())
+        glDrawElements(GL_TRIANGLES, (GLsizei)m.indexCount(), GL_UNSIGNED_INT, (const void *)m.longIndices.data());
+    else
+        glDrawElements(GL_TRIANGLES, (GLsizei)m.indexCount(), GL_UNSIGNED_SHORT, (const void *)m.shortIndices.data());
+    if(fromBufferObject)
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return renderer;
+}
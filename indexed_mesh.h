@@ -0,0 +1,313 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef INDEXED_MESH_H_INCLUDED
+#define INDEXED_MESH_H_INCLUDED
+
+#include "mesh.h"
+#include <cstdint>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+
+using namespace std;
+
+class IndexedMesh_t;
+
+typedef shared_ptr<IndexedMesh_t> IndexedMesh;
+
+/** a mesh with shared vertices : a vertex buffer plus an index buffer with 3 indices per triangle.
+ * indices are 16 bits until the mesh has more than 65536 vertices.
+ */
+class IndexedMesh_t final
+{
+    friend Renderer &operator <<(Renderer &renderer, const IndexedMesh_t &m);
+private:
+    vector<float> points, colors, textureCoords;
+    vector<uint16_t> shortIndices;
+    vector<uint32_t> longIndices;
+    bool useLongIndices = false;
+    Image textureInternal;
+    mutable MeshBufferObject bufferObject;
+    static constexpr size_t floatsPerPoint = 3, floatsPerColor = 4, floatsPerTextureCoord = 2, indicesPerTriangle = 3;
+    static constexpr size_t maxShortIndexVertexCount = 65536;
+    /// all of a vertex's floats, compared bit for bit when welding
+    struct VertexKey final
+    {
+        float values[floatsPerPoint + floatsPerColor + floatsPerTextureCoord];
+        bool operator ==(const VertexKey &rt) const
+        {
+            return memcmp((const void *)values, (const void *)rt.values, sizeof(values)) == 0;
+        }
+    };
+    struct VertexKeyHash final
+    {
+        size_t operator ()(const VertexKey &key) const
+        {
+            size_t retval = 0;
+            for(float value : key.values)
+            {
+                uint32_t bits;
+                memcpy((void *)&bits, (const void *)&value, sizeof(bits));
+                retval = (retval ^ bits) * 0x9E3779B1U + (retval >> 16);
+            }
+            return retval;
+        }
+    };
+    void switchToLongIndices()
+    {
+        useLongIndices = true;
+        longIndices.assign(shortIndices.begin(), shortIndices.end());
+        shortIndices.clear();
+        shortIndices.shrink_to_fit();
+    }
+    void checkTexture(const Image &texture)
+    {
+        if(textureInternal)
+        {
+            if(texture && texture != textureInternal)
+            {
+                throw ImageNotSameException();
+            }
+        }
+        else
+        {
+            textureInternal = texture;
+        }
+    }
+public:
+    IndexedMesh_t()
+    {
+    }
+
+    explicit IndexedMesh_t(Image texture)
+        : textureInternal(texture)
+    {
+    }
+
+    /// make an indexed mesh from a mesh, merging identical vertices
+    explicit IndexedMesh_t(const Mesh_t &mesh)
+        : textureInternal(mesh.texture())
+    {
+        unordered_map<VertexKey, size_t, VertexKeyHash> vertexIndices;
+        vertexIndices.reserve(mesh.size() * indicesPerTriangle);
+        for(const Triangle &tri : mesh)
+        {
+            size_t indices[indicesPerTriangle];
+            for(size_t i = 0; i < indicesPerTriangle; i++)
+            {
+                const VertexKey key = {{tri.p[i].x, tri.p[i].y, tri.p[i].z, tri.c[i].r, tri.c[i].g, tri.c[i].b, tri.c[i].a, tri.t[i].u, tri.t[i].v}};
+                auto iter = vertexIndices.find(key);
+                if(iter == vertexIndices.end())
+                {
+                    indices[i] = addVertex(tri.p[i], tri.c[i], tri.t[i]);
+                    vertexIndices.insert(make_pair(key, indices[i]));
+                }
+                else
+                    indices[i] = get<1>(*iter);
+            }
+            addTriangle(indices[0], indices[1], indices[2]);
+        }
+    }
+
+    const Image &texture() const
+    {
+        return textureInternal;
+    }
+
+    size_t vertexCount() const
+    {
+        return points.size() / floatsPerPoint;
+    }
+
+    size_t indexCount() const
+    {
+        return useLongIndices ? longIndices.size() : shortIndices.size();
+    }
+
+    /// @return the number of triangles
+    size_t size() const
+    {
+        return indexCount() / indicesPerTriangle;
+    }
+
+    bool usesLongIndices() const
+    {
+        return useLongIndices;
+    }
+
+    void reserve(size_t vertexCount, size_t triangleCount)
+    {
+        points.reserve(vertexCount * floatsPerPoint);
+        colors.reserve(vertexCount * floatsPerColor);
+        textureCoords.reserve(vertexCount * floatsPerTextureCoord);
+        if(useLongIndices || vertexCount > maxShortIndexVertexCount)
+            longIndices.reserve(triangleCount * indicesPerTriangle);
+        else
+            shortIndices.reserve(triangleCount * indicesPerTriangle);
+    }
+
+    /// @return the index of the new vertex
+    size_t addVertex(VectorF p, Color c, TextureCoord t)
+    {
+        bufferObject.invalidate();
+        size_t retval = vertexCount();
+        if(retval >= maxShortIndexVertexCount && !useLongIndices)
+            switchToLongIndices();
+        points.push_back(p.x);
+        points.push_back(p.y);
+        points.push_back(p.z);
+        colors.push_back(c.r);
+        colors.push_back(c.g);
+        colors.push_back(c.b);
+        colors.push_back(c.a);
+        textureCoords.push_back(t.u);
+        textureCoords.push_back(t.v);
+        return retval;
+    }
+
+    void addTriangle(size_t a, size_t b, size_t c)
+    {
+        assert(a < vertexCount() && b < vertexCount() && c < vertexCount());
+        if(useLongIndices)
+        {
+            longIndices.push_back((uint32_t)a);
+            longIndices.push_back((uint32_t)b);
+            longIndices.push_back((uint32_t)c);
+        }
+        else
+        {
+            shortIndices.push_back((uint16_t)a);
+            shortIndices.push_back((uint16_t)b);
+            shortIndices.push_back((uint16_t)c);
+        }
+    }
+
+    size_t getIndex(size_t index) const
+    {
+        return useLongIndices ? longIndices[index] : shortIndices[index];
+    }
+
+    VectorF getPoint(size_t vertex) const
+    {
+        const float *p = &points[vertex * floatsPerPoint];
+        return VectorF(p[0], p[1], p[2]);
+    }
+
+    Color getColor(size_t vertex) const
+    {
+        const float *c = &colors[vertex * floatsPerColor];
+        return Color(c[0], c[1], c[2], c[3]);
+    }
+
+    TextureCoord getTextureCoord(size_t vertex) const
+    {
+        const float *t = &textureCoords[vertex * floatsPerTextureCoord];
+        return TextureCoord(t[0], t[1]);
+    }
+
+    Triangle getTriangle(size_t index) const
+    {
+        Triangle retval;
+        for(size_t i = 0; i < indicesPerTriangle; i++)
+        {
+            size_t vertex = getIndex(index * indicesPerTriangle + i);
+            retval.p[i] = getPoint(vertex);
+            retval.c[i] = getColor(vertex);
+            retval.t[i] = getTextureCoord(vertex);
+        }
+        return retval;
+    }
+
+    /** add a transformed copy of another indexed mesh. only the unique vertices are transformed.
+     *
+     * @param m the mesh to add
+     * @param tform the transform to apply to the vertices of <code>m</code>
+     * @param factor the color to scale the vertex colors of <code>m</code> by
+     */
+    void add(const IndexedMesh_t &m, const Matrix &tform = Matrix::identity(), Color factor = Color(1, 1, 1, 1))
+    {
+        checkTexture(m.texture());
+        size_t vertexOffset = vertexCount();
+        reserve(vertexOffset + m.vertexCount(), size() + m.size());
+        for(size_t i = 0; i < m.vertexCount(); i++)
+        {
+            addVertex(transform(tform, m.getPoint(i)), scale(m.getColor(i), factor), m.getTextureCoord(i));
+        }
+        for(size_t i = 0; i < m.indexCount(); i += indicesPerTriangle)
+        {
+            addTriangle(m.getIndex(i) + vertexOffset, m.getIndex(i + 1) + vertexOffset, m.getIndex(i + 2) + vertexOffset);
+        }
+    }
+
+    void add(IndexedMesh m, const Matrix &tform = Matrix::identity(), Color factor = Color(1, 1, 1, 1))
+    {
+        add(*m, tform, factor);
+    }
+
+    /** renumber the vertices in the order that the triangles first use them so that drawing reads the vertex data in order.
+     * this only helps fetching vertices : the triangles keep their order, so it does nothing for the post-transform vertex cache
+     */
+    void orderVerticesByFirstUse()
+    {
+        const size_t unused = (size_t)-1;
+        vector<size_t> newIndices(vertexCount(), unused);
+        vector<size_t> order;
+        order.reserve(vertexCount());
+        for(size_t i = 0; i < indexCount(); i++)
+        {
+            size_t vertex = getIndex(i);
+            if(newIndices[vertex] == unused)
+            {
+                newIndices[vertex] = order.size();
+                order.push_back(vertex);
+            }
+        }
+        IndexedMesh_t retval(texture());
+        retval.reserve(order.size(), size());
+        for(size_t vertex : order)
+        {
+            retval.addVertex(getPoint(vertex), getColor(vertex), getTextureCoord(vertex));
+        }
+        for(size_t i = 0; i < indexCount(); i += indicesPerTriangle)
+        {
+            retval.addTriangle(newIndices[getIndex(i)], newIndices[getIndex(i + 1)], newIndices[getIndex(i + 2)]);
+        }
+        *this = std::move(retval);
+    }
+
+    /// @return this mesh with the vertices duplicated for every triangle
+    Mesh expand() const
+    {
+        vector<Triangle> triangles;
+        triangles.reserve(size());
+        for(size_t i = 0; i < size(); i++)
+        {
+            triangles.push_back(getTriangle(i));
+        }
+        return Mesh(new Mesh_t(texture(), triangles));
+    }
+};
+
+Renderer &operator <<(Renderer &renderer, const IndexedMesh_t &m);
+
+inline Renderer &operator <<(Renderer &renderer, IndexedMesh m)
+{
+    return renderer << *m;
+}
+
+#endif // INDEXED_MESH_H_INCLUDED
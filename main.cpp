@@ -20,23 +20,45 @@
 #include "physics.h"
 #include "generate.h"
 #include "texture_atlas.h"
+#include "scene.h"
+#include "frame_profiler.h"
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <cstdlib>
 
 using namespace std;
 
 struct MyObject
 {
     shared_ptr<PhysicsObject> physicsObject;
-    TransformedMesh getMesh()
+    shared_ptr<SceneNode> sceneNode;
+    static Mesh makeBoxMesh(TextureDescriptor td)
     {
-        TextureDescriptor td = TextureAtlas::OakWood.td();
-        if(physicsObject->isStatic())
-            td = TextureAtlas::BirchWood.td();
-        else if(physicsObject->isSupported())
-            td = TextureAtlas::JungleWood.td();
-        Mesh boxMesh = Generate::unitBox(td, td, TextureAtlas::WoodEnd.td(), TextureAtlas::WoodEnd.td(), td, td);
-        return transform(Matrix::scale(2).concat(Matrix::translate(-1, -1, -1)).concat(Matrix::scale(physicsObject->getExtents())).concat(Matrix::translate((VectorF)physicsObject->getPosition())), boxMesh);
+        return Generate::unitBox(td, td, TextureAtlas::WoodEnd.td(), TextureAtlas::WoodEnd.td(), td, td);
+    }
+    TransformedMesh getMesh(const PhysicsObjectState & state)
+    {
+        static const Mesh normalBoxMesh = makeBoxMesh(TextureAtlas::OakWood.td());
+        static const Mesh staticBoxMesh = makeBoxMesh(TextureAtlas::BirchWood.td());
+        static const Mesh supportedBoxMesh = makeBoxMesh(TextureAtlas::JungleWood.td());
+        Mesh boxMesh = normalBoxMesh;
+        if(state.isStatic)
+            boxMesh = staticBoxMesh;
+        else if(state.isSupported)
+            boxMesh = supportedBoxMesh;
+        return transform(Matrix::scale(2).concat(Matrix::translate(-1, -1, -1)).concat(Matrix::scale(state.extents)).concat(Matrix::translate((VectorF)state.position)), boxMesh);
+    }
+    void updateSceneNode(Scene & scene, const PhysicsObjectState & state)
+    {
+        TransformedMesh mesh = getMesh(state);
+        if(sceneNode == nullptr)
+        {
+            sceneNode = scene.add(mesh.mesh, mesh.tform, state.isStatic);
+            return;
+        }
+        sceneNode->setMesh(mesh.mesh);
+        sceneNode->setTransform(mesh.tform);
     }
     MyObject(shared_ptr<PhysicsObject> physicsObject)
         : physicsObject(physicsObject)
@@ -54,6 +76,68 @@ float frand(float max = 1)
     return frand(0, max);
 }
 
+namespace
+{
+ofstream frameCSV;
+size_t nextCSVFrame = 0;
+
+/// write the frames recorded since the last call. also run at exit so a fatal error still keeps the frames
+void writeFrameCSV()
+{
+    if(!frameCSV.is_open())
+        return;
+    nextCSVFrame = FrameProfiler::global().writeCSV(frameCSV, nextCSVFrame);
+    frameCSV.flush();
+}
+
+/** ends the main loop on quit or Alt-F4 instead of letting the default handler call exit,
+ * so the physics thread is stopped and joined before the atexit handlers shut everything down
+ */
+class QuitEventHandler final : public EventHandler
+{
+public:
+    bool quit = false;
+    virtual bool handleMouseUp(MouseUpEvent &) override
+    {
+        return false;
+    }
+    virtual bool handleMouseDown(MouseDownEvent &) override
+    {
+        return false;
+    }
+    virtual bool handleMouseMove(MouseMoveEvent &) override
+    {
+        return false;
+    }
+    virtual bool handleMouseScroll(MouseScrollEvent &) override
+    {
+        return false;
+    }
+    virtual bool handleKeyUp(KeyUpEvent &) override
+    {
+        return false;
+    }
+    virtual bool handleKeyDown(KeyDownEvent &event) override
+    {
+        if(event.key == KeyboardKey_F4 && (event.mods & KeyboardModifiers_Alt) != 0)
+        {
+            quit = true;
+            return true;
+        }
+        return false;
+    }
+    virtual bool handleKeyPress(KeyPressEvent &) override
+    {
+        return false;
+    }
+    virtual bool handleQuit(QuitEvent &) override
+    {
+        quit = true;
+        return true;
+    }
+};
+}
+
 int myMain(vector<wstring> args)
 {
     shared_ptr<PhysicsWorld> physicsWorld = make_shared<PhysicsWorld>();
@@ -130,23 +214,66 @@ int myMain(vector<wstring> args)
     cout << idealHeight << " : " << objects.back().physicsObject->getPosition().y << "\n" << flush;
     return 0;
 #else
+    bool showFrameGraph = false;
+    for(size_t i = 1; i < args.size(); i++)
+    {
+        if(args[i] == L"--frame-graph")
+            showFrameGraph = true;
+        else if(args[i] == L"--frame-csv" && i + 1 < args.size())
+        {
+            frameCSV.open(wcsrtombs(args[++i]).c_str());
+            if(!frameCSV)
+            {
+                cerr << "can't open " << wcsrtombs(args[i]) << "\n";
+                return 1;
+            }
+        }
+    }
+    if(frameCSV.is_open())
+    {
+        FrameProfiler::global(); // construct it first so it's still alive when writeFrameCSV runs at exit
+        atexit(writeFrameCSV);
+    }
     startGraphics();
     Renderer renderer;
+    PhysicsWorldThread physicsThread(physicsWorld, 1 / 120.0, [](chrono::steady_clock::duration stepTime)
+    {
+        FrameProfiler::global().addTime(FrameProfiler::Physics, stepTime);
+    });
+    Scene scene;
+    shared_ptr<QuitEventHandler> quitEventHandler = make_shared<QuitEventHandler>();
     while(true)
     {
-        Display::handleEvents(nullptr);
+        Display::handleEvents(quitEventHandler);
+        if(quitEventHandler->quit)
+            break;
         Display::initFrame();
         glClearColor(0, 0, 0, 0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        Mesh theMesh = Mesh(new Mesh_t());
-        for(MyObject & obj : objects)
+        const PhysicsSnapshot & snapshot = physicsWorld->getSnapshot();
+        float t = snapshot.getInterpolationFactor();
+        Matrix viewMatrix = Matrix::rotateY(snapshot.getTime(t) * M_PI / 10).concat(Matrix::translate(0, 0, -10));
+        {
+            FrameProfiler::Scope profilerScope(FrameProfiler::MeshBuild);
+            PhysicsObjectState state;
+            for(MyObject & obj : objects)
+            {
+                if(snapshot.getState(obj.physicsObject, t, state))
+                    obj.updateSceneNode(scene, state);
+            }
+            if(snapshot.getState(floorObject.physicsObject, t, state))
+                floorObject.updateSceneNode(scene, state);
+        }
+        scene.render(renderer, viewMatrix);
+        if(showFrameGraph)
         {
-            theMesh->add(obj.getMesh());
+            Display::initOverlay();
+            const float graphHeight = 0.04f;
+            renderer << transform(Matrix::scale(graphHeight).concat(Matrix::translate(0.005f - 0.1f * Display::scaleX(), 0.005f - 0.1f * Display::scaleY(), -0.1f)), FrameProfiler::global().graphMesh());
         }
-        theMesh->add(floorObject.getMesh());
-        renderer << transform(Matrix::rotateY(physicsWorld->getCurrentTime() * M_PI / 10).concat(Matrix::translate(0, 0, -10)), theMesh);
         Display::flip(60);
-        physicsWorld->stepTime(Display::frameDeltaTime());
+        if(frameCSV.is_open() && FrameProfiler::global().frameCount() >= nextCSVFrame + FrameProfiler::historySize / 2)
+            writeFrameCSV();
     }
     return 0;
 #endif
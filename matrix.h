@@ -19,6 +19,10 @@
 #define MATRIX_H
 
 #include "vector.h"
+#include <cstddef>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 /** 4x4 matrix for 3D transformation with last row always equal to [0 0 0 1]
  *
@@ -443,6 +447,49 @@ inline VectorF transform(const Matrix & m, VectorF v)
     return m.apply(v);
 }
 
+/** transform packed points in place
+ *
+ * @param m the matrix to transform by
+ * @param xyz the points, stored as x, y, z, x, y, z, ...
+ * @param n the number of points
+ */
+inline void transformPoints(const Matrix & m, float * xyz, size_t n)
+{
+    size_t i = 0;
+#ifdef __SSE__
+    const __m128 m00 = _mm_set1_ps(m.x00), m10 = _mm_set1_ps(m.x10), m20 = _mm_set1_ps(m.x20), m30 = _mm_set1_ps(m.x30);
+    const __m128 m01 = _mm_set1_ps(m.x01), m11 = _mm_set1_ps(m.x11), m21 = _mm_set1_ps(m.x21), m31 = _mm_set1_ps(m.x31);
+    const __m128 m02 = _mm_set1_ps(m.x02), m12 = _mm_set1_ps(m.x12), m22 = _mm_set1_ps(m.x22), m32 = _mm_set1_ps(m.x32);
+    for(; i + 4 <= n; i += 4, xyz += 12)
+    {
+        // 4 points are in 3 registers : x0 y0 z0 x1, y1 z1 x2 y2, z2 x3 y3 z3
+        __m128 a0 = _mm_loadu_ps(xyz), a1 = _mm_loadu_ps(xyz + 4), a2 = _mm_loadu_ps(xyz + 8);
+        __m128 t = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+        __m128 u = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+        __m128 x = _mm_shuffle_ps(a0, t, _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 y = _mm_shuffle_ps(u, t, _MM_SHUFFLE(3, 1, 2, 0));
+        __m128 z = _mm_shuffle_ps(u, a2, _MM_SHUFFLE(3, 0, 3, 1));
+        __m128 newX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_add_ps(_mm_mul_ps(z, m20), m30));
+        __m128 newY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_add_ps(_mm_mul_ps(z, m21), m31));
+        __m128 newZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_add_ps(_mm_mul_ps(z, m22), m32));
+        __m128 xy01 = _mm_unpacklo_ps(newX, newY); // x0 y0 x1 y1
+        __m128 xy23 = _mm_unpackhi_ps(newX, newY); // x2 y2 x3 y3
+        __m128 q = _mm_shuffle_ps(newZ, xy01, _MM_SHUFFLE(3, 2, 1, 0)); // z0 z1 x1 y1
+        __m128 r = _mm_shuffle_ps(newZ, xy23, _MM_SHUFFLE(3, 2, 3, 2)); // z2 z3 x3 y3
+        _mm_storeu_ps(xyz, _mm_shuffle_ps(xy01, q, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(xyz + 4, _mm_shuffle_ps(q, xy23, _MM_SHUFFLE(1, 0, 1, 3)));
+        _mm_storeu_ps(xyz + 8, _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 3, 2, 0)));
+    }
+#endif
+    for(; i < n; i++, xyz += 3)
+    {
+        VectorF v = m.apply(VectorF(xyz[0], xyz[1], xyz[2]));
+        xyz[0] = v.x;
+        xyz[1] = v.y;
+        xyz[2] = v.z;
+    }
+}
+
 inline bool operator ==(const Matrix & a, const Matrix & b)
 {
     for(int y = 0; y < 4; y++)
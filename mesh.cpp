@@ -15,17 +15,169 @@
  * MA 02110-1301, USA.
  *
  */
+#define GL_GLEXT_PROTOTYPES
 #include "mesh.h"
 #include "platform.h"
+#include "frustum.h"
 #include <iostream>
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+mutex freedBuffersLock;
+vector<GLuint> freedBuffers;
+}
+
+MeshBufferObject::~MeshBufferObject()
+{
+    static_assert(sizeof(uint32_t) == sizeof(GLuint), "GLuint is not the same size as uint32_t");
+    if(buffer != 0 && graphicsRunning()) // the buffers went away with the context once graphics ended
+    {
+        lock_guard<mutex> lock(freedBuffersLock);
+        freedBuffers.push_back(buffer);
+    }
+}
+
+void MeshBufferObject::deleteFreedBuffers()
+{
+    vector<GLuint> buffers;
+    {
+        lock_guard<mutex> lock(freedBuffersLock);
+        buffers.swap(freedBuffers);
+    }
+    if(!buffers.empty())
+        glDeleteBuffers((GLsizei)buffers.size(), buffers.data());
+}
+
+bool MeshBufferObject::bind(bool uploadNow, bool &needsUpload)
+{
+    needsUpload = false;
+    if(valid)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        return true;
+    }
+    if(drawCount++ == 0 && !uploadNow)
+        return false;
+    if(buffer == 0)
+        glGenBuffers(1, (GLuint *)&buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    needsUpload = true;
+    valid = true;
+    return true;
+}
+
+/** bind the buffer object for a mesh, uploading it if it changed.
+ *
+ * @param m the mesh to bind
+ * @param uploadNow upload the mesh even if this is the first time it's drawn
+ * @return if the buffer object was bound
+ */
+bool Renderer::bindBufferObject(const Mesh_t & m, bool uploadNow)
+{
+    bool needsUpload;
+    if(!m.bufferObject.bind(uploadNow, needsUpload))
+        return false;
+    if(needsUpload)
+    {
+        size_t pointsSize = sizeof(float) * m.points.size();
+        size_t textureCoordsSize = sizeof(float) * m.textureCoords.size();
+        size_t colorsSize = sizeof(float) * m.colors.size();
+        glBufferData(GL_ARRAY_BUFFER, pointsSize + textureCoordsSize + colorsSize, nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, pointsSize, (const void *)m.points.data());
+        glBufferSubData(GL_ARRAY_BUFFER, pointsSize, textureCoordsSize, (const void *)m.textureCoords.data());
+        glBufferSubData(GL_ARRAY_BUFFER, pointsSize + textureCoordsSize, colorsSize, (const void *)m.colors.data());
+    }
+    return true;
+}
+
+void Renderer::setArrayPointers(const Mesh_t & m, bool fromBufferObject)
+{
+    if(fromBufferObject)
+    {
+        size_t pointsSize = sizeof(float) * m.points.size();
+        size_t textureCoordsSize = sizeof(float) * m.textureCoords.size();
+        glVertexPointer(3, GL_FLOAT, 0, (const void *)0);
+        glTexCoordPointer(2, GL_FLOAT, 0, (const void *)pointsSize);
+        glColorPointer(4, GL_FLOAT, 0, (const void *)(pointsSize + textureCoordsSize));
+    }
+    else
+    {
+        glVertexPointer(3, GL_FLOAT, 0, (const void *)m.points.data());
+        glTexCoordPointer(2, GL_FLOAT, 0, (const void *)m.textureCoords.data());
+        glColorPointer(4, GL_FLOAT, 0, (const void *)m.colors.data());
+    }
+}
 
 Renderer & Renderer::operator <<(const Mesh_t & m)
 {
+    if(m.size() == 0)
+        return *this;
     m.texture().bind();
-    glVertexPointer(3, GL_FLOAT, 0, (const void *)m.points.data());
-    glTexCoordPointer(2, GL_FLOAT, 0, (const void *)m.textureCoords.data());
-    glColorPointer(4, GL_FLOAT, 0, (const void *)m.colors.data());
+    bool fromBufferObject = bindBufferObject(m);
+    setArrayPointers(m, fromBufferObject);
     glDrawArrays(GL_TRIANGLES, 0, (GLint)m.size() * 3);
+    if(fromBufferObject)
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     return *this;
 }
 
+Renderer & Renderer::operator <<(TransformedMesh m)
+{
+    if(m.mesh == nullptr || m.mesh->size() == 0)
+        return *this;
+    Mesh_t m2(m);
+    operator <<(m2);
+    return *this;
+}
+
+Renderer & Renderer::operator <<(const vector<TransformedMesh> & meshes)
+{
+    vector<const TransformedMesh *> instances;
+    vector<const TransformedMesh *> scaledInstances;
+    instances.reserve(meshes.size());
+    const Frustum frustum = Frustum::current();
+    for(const TransformedMesh & tm : meshes)
+    {
+        if(tm.mesh == nullptr || tm.mesh->size() == 0 || !frustum.visible(tm))
+            continue;
+        if(tm.factor.r != 1 || tm.factor.g != 1 || tm.factor.b != 1 || tm.factor.a != 1)
+            scaledInstances.push_back(&tm); // the fixed function pipeline can't scale the color array so these are transformed on the CPU
+        else
+            instances.push_back(&tm);
+    }
+    stable_sort(instances.begin(), instances.end(), [](const TransformedMesh * a, const TransformedMesh * b)
+    {
+        return a->mesh.get() < b->mesh.get();
+    });
+    GLint matrixMode;
+    glGetIntegerv(GL_MATRIX_MODE, &matrixMode);
+    glMatrixMode(GL_MODELVIEW);
+    for(auto groupStart = instances.begin(); groupStart != instances.end();)
+    {
+        const Mesh_t & m = *(*groupStart)->mesh;
+        auto groupEnd = groupStart + 1;
+        while(groupEnd != instances.end() && (*groupEnd)->mesh.get() == &m)
+            groupEnd++;
+        m.texture().bind();
+        bool fromBufferObject = bindBufferObject(m, groupEnd - groupStart > 1);
+        setArrayPointers(m, fromBufferObject);
+        for(auto i = groupStart; i != groupEnd; i++)
+        {
+            glPushMatrix();
+            glMultMatrix((*i)->tform);
+            glDrawArrays(GL_TRIANGLES, 0, (GLint)m.size() * 3);
+            glPopMatrix();
+        }
+        if(fromBufferObject)
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        groupStart = groupEnd;
+    }
+    glMatrixMode((GLenum)matrixMode);
+    for(const TransformedMesh * tm : scaledInstances)
+    {
+        operator <<(Mesh_t(*tm));
+    }
+    return *this;
+}
@@ -24,6 +24,7 @@
 #include <memory>
 #include <iterator>
 #include <ostream>
+#include <algorithm>
 #include "image.h"
 #include "texture_descriptor.h"
 
@@ -120,6 +121,56 @@ inline TransformedMesh scaleColors(Color factor, TransformedMesh mesh)
     return TransformedMesh(mesh.mesh, mesh.tform, scale(mesh.factor, factor));
 }
 
+/// an axis aligned box
+struct BoundingBox
+{
+    VectorF minCorner, maxCorner;
+    /// make an empty box
+    BoundingBox()
+        : minCorner(INFINITY), maxCorner(-INFINITY)
+    {
+    }
+    BoundingBox(VectorF minCorner, VectorF maxCorner)
+        : minCorner(minCorner), maxCorner(maxCorner)
+    {
+    }
+    bool empty() const
+    {
+        return minCorner.x > maxCorner.x || minCorner.y > maxCorner.y || minCorner.z > maxCorner.z;
+    }
+    VectorF center() const
+    {
+        return 0.5f * (minCorner + maxCorner);
+    }
+    /// @return the distance from the center to the maximum corner
+    VectorF halfExtents() const
+    {
+        return 0.5f * (maxCorner - minCorner);
+    }
+    void add(VectorF p)
+    {
+        minCorner.x = min(minCorner.x, p.x);
+        minCorner.y = min(minCorner.y, p.y);
+        minCorner.z = min(minCorner.z, p.z);
+        maxCorner.x = max(maxCorner.x, p.x);
+        maxCorner.y = max(maxCorner.y, p.y);
+        maxCorner.z = max(maxCorner.z, p.z);
+    }
+};
+
+/// @return the axis aligned box around the transformed box
+inline BoundingBox transform(const Matrix &m, const BoundingBox &box)
+{
+    if(box.empty())
+        return box;
+    VectorF center = transform(m, box.center());
+    VectorF e = box.halfExtents();
+    VectorF halfExtents = VectorF(abs(m.x00) * e.x + abs(m.x10) * e.y + abs(m.x20) * e.z,
+                                  abs(m.x01) * e.x + abs(m.x11) * e.y + abs(m.x21) * e.z,
+                                  abs(m.x02) * e.x + abs(m.x12) * e.y + abs(m.x22) * e.z);
+    return BoundingBox(center - halfExtents, center + halfExtents);
+}
+
 class ImageNotSameException final : public runtime_error
 {
 public:
@@ -129,6 +180,47 @@ public:
     }
 };
 
+/// the copy of a mesh on the GPU
+class MeshBufferObject final
+{
+private:
+    uint32_t buffer = 0;
+    bool valid = false;
+    size_t drawCount = 0;
+public:
+    MeshBufferObject()
+    {
+    }
+    MeshBufferObject(const MeshBufferObject &)
+        : MeshBufferObject()
+    {
+    }
+    const MeshBufferObject &operator =(const MeshBufferObject &)
+    {
+        invalidate();
+        return *this;
+    }
+    ~MeshBufferObject();
+    void invalidate()
+    {
+        valid = false;
+        drawCount = 0;
+    }
+    /** bind the buffer object to GL_ARRAY_BUFFER if the mesh should be drawn from it.
+     * meshes are only uploaded once they are drawn a second time without changing so that temporary meshes don't waste time creating buffers.
+     *
+     * @param uploadNow use the buffer object even if this is the first time the mesh is drawn
+     * @param needsUpload set to if the caller needs to upload the mesh into the bound buffer
+     * @return if the buffer object was bound
+     */
+    bool bind(bool uploadNow, bool &needsUpload);
+    /** delete the buffers of the buffer objects destroyed since the last call.
+     * buffer objects can be destroyed on any thread so they only queue their buffers,
+     * this must be called on the thread with the OpenGL context. Display::initFrame calls it.
+     */
+    static void deleteFreedBuffers();
+};
+
 class Mesh_t final
 {
 private:
@@ -139,6 +231,14 @@ private:
                             floatsPerColor = 4, colorsPerTriangle = 3,
                             floatsPerTextureCoord = 2, textureCoordsPerTriangle = 3;
     friend class Renderer;
+    mutable MeshBufferObject bufferObject;
+    mutable BoundingBox boundsInternal;
+    mutable bool boundsValid = false;
+    void invalidate()
+    {
+        bufferObject.invalidate();
+        boundsValid = false;
+    }
 public:
     Mesh_t()
     {
@@ -239,31 +339,8 @@ public:
         textureInternal = tm.mesh->texture();
         length = tm.mesh->length;
 
-        for(auto i = points.begin(); i != points.end(); i += floatsPerPoint)
-        {
-            VectorF v;
-            v.x = i[0];
-            v.y = i[1];
-            v.z = i[2];
-            v = transform(tm.tform, v);
-            i[0] = v.x;
-            i[1] = v.y;
-            i[2] = v.z;
-        }
-
-        for(auto i = colors.begin(); i != colors.end(); i += floatsPerColor)
-        {
-            Color c;
-            c.r = i[0];
-            c.g = i[1];
-            c.b = i[2];
-            c.a = i[3];
-            c = scale(c, tm.factor);
-            i[0] = c.r;
-            i[1] = c.g;
-            i[2] = c.b;
-            i[3] = c.a;
-        }
+        transformPoints(tm.tform, points.data(), points.size() / floatsPerPoint);
+        scaleColors(tm.factor, colors.data(), colors.size() / floatsPerColor);
     }
 
     const Image &texture() const
@@ -271,6 +348,22 @@ public:
         return textureInternal;
     }
 
+    /// @return the box around all the points, calculated the first time it's needed after the mesh changes
+    const BoundingBox &bounds() const
+    {
+        if(!boundsValid)
+        {
+            BoundingBox box;
+            for(auto i = points.begin(); i != points.end(); i += floatsPerPoint)
+            {
+                box.add(VectorF(i[0], i[1], i[2]));
+            }
+            boundsInternal = box;
+            boundsValid = true;
+        }
+        return boundsInternal;
+    }
+
     friend class const_iterator;
     class const_iterator final : public iterator<iterator_traits<vector<float>::iterator>::value_type, const Triangle, ssize_t>
     {
@@ -428,6 +521,44 @@ public:
         return const_reverse_iterator(begin());
     }
 
+    /// allocate space for triangleCount triangles in total
+    void reserve(size_t triangleCount)
+    {
+        points.reserve(floatsPerPoint * pointsPerTriangle * triangleCount);
+        colors.reserve(floatsPerColor * colorsPerTriangle * triangleCount);
+        textureCoords.reserve(floatsPerTextureCoord * textureCoordsPerTriangle * triangleCount);
+    }
+
+    /// add one triangle that uses this mesh's texture
+    void add(const Triangle &tri)
+    {
+        invalidate();
+        length++;
+        for(int i = 0; i < 3; i++)
+        {
+            points.push_back(tri.p[i].x);
+            points.push_back(tri.p[i].y);
+            points.push_back(tri.p[i].z);
+            colors.push_back(tri.c[i].r);
+            colors.push_back(tri.c[i].g);
+            colors.push_back(tri.c[i].b);
+            colors.push_back(tri.c[i].a);
+            textureCoords.push_back(tri.t[i].u);
+            textureCoords.push_back(tri.t[i].v);
+        }
+    }
+
+    /// remove all the triangles, keeping the allocated memory for reuse
+    void clear()
+    {
+        invalidate();
+        length = 0;
+        points.clear();
+        colors.clear();
+        textureCoords.clear();
+        textureInternal = Image();
+    }
+
     void add(const Mesh_t &m)
     {
         if(texture())
@@ -442,6 +573,7 @@ public:
             textureInternal = m.texture();
         }
 
+        invalidate();
         length += m.length;
         points.insert(points.end(), m.points.begin(), m.points.end());
         colors.insert(colors.end(), m.colors.begin(), m.colors.end());
@@ -455,105 +587,200 @@ public:
 
     void add(TransformedMesh m)
     {
-        Mesh_t m2(m);
-        add(m2);
+        if(m.mesh == nullptr)
+            return;
+        if(m.mesh.get() == this)
+        {
+            Mesh_t m2(m);
+            add(m2);
+            return;
+        }
+        size_t pointsStart = points.size(), colorsStart = colors.size();
+        add(*m.mesh);
+        transformPoints(m.tform, points.data() + pointsStart, (points.size() - pointsStart) / floatsPerPoint);
+        scaleColors(m.factor, colors.data() + colorsStart, (colors.size() - colorsStart) / floatsPerColor);
+    }
+
+    /** combine meshes into one, copying the parts in parallel
+     *
+     * @param parts the meshes to combine, in order
+     * @param jobs the job system to copy with
+     * @return the new mesh
+     */
+    static Mesh merge(const vector<const Mesh_t *> &parts, JobSystem &jobs = JobSystem::global())
+    {
+        Mesh retval = Mesh(new Mesh_t());
+        vector<size_t> offsets(parts.size() + 1, 0); // where each part starts, in triangles
+        for(size_t i = 0; i < parts.size(); i++)
+        {
+            const Mesh_t &part = *parts[i];
+            if(part.texture())
+            {
+                if(retval->texture() && retval->texture() != part.texture())
+                {
+                    throw ImageNotSameException();
+                }
+                retval->textureInternal = part.texture();
+            }
+            offsets[i + 1] = offsets[i] + part.length;
+        }
+        retval->length = offsets.back();
+        retval->points.resize(floatsPerPoint * pointsPerTriangle * retval->length);
+        retval->colors.resize(floatsPerColor * colorsPerTriangle * retval->length);
+        retval->textureCoords.resize(floatsPerTextureCoord * textureCoordsPerTriangle * retval->length);
+        Mesh_t &dest = *retval;
+        jobs.parallelFor(parts.size(), [&](size_t i)
+        {
+            const Mesh_t &part = *parts[i];
+            copy(part.points.begin(), part.points.end(), dest.points.begin() + floatsPerPoint * pointsPerTriangle * offsets[i]);
+            copy(part.colors.begin(), part.colors.end(), dest.colors.begin() + floatsPerColor * colorsPerTriangle * offsets[i]);
+            copy(part.textureCoords.begin(), part.textureCoords.end(), dest.textureCoords.begin() + floatsPerTextureCoord * textureCoordsPerTriangle * offsets[i]);
+        });
+        return retval;
     }
 
-    friend Mesh interpolateColors(Mesh dest, Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ);
-    friend Mesh interpolateColors(Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ);
-    friend Mesh lightColors(Mesh dest, Mesh mesh, VectorF lightDir, float ambient, float diffuse);
-};
+    static Mesh merge(const vector<Mesh_t> &parts, JobSystem &jobs = JobSystem::global())
+    {
+        vector<const Mesh_t *> partPointers;
+        partPointers.reserve(parts.size());
+        for(const Mesh_t &part : parts)
+        {
+            partPointers.push_back(&part);
+        }
+        return merge(partPointers, jobs);
+    }
 
-inline Mesh interpolateColors(Mesh dest, Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ)
-{
-    assert(dest && mesh);
+private:
+    /// scale the colors of vertexCount vertices by the corner colors of the unit box, interpolated at each point
+    static void interpolateColorArrays(const float *points, float *colors, size_t vertexCount, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ)
+    {
+        for(size_t i = 0; i < vertexCount; i++, points += floatsPerPoint, colors += floatsPerColor)
+        {
+            float x = points[0], y = points[1], z = points[2];
+            Color c = interpolate(x, interpolate(y, interpolate(z, cNXNYNZ, cNXNYPZ), interpolate(z, cNXPYNZ, cNXPYPZ)), interpolate(y, interpolate(z, cPXNYNZ, cPXNYPZ), interpolate(z, cPXPYNZ, cPXPYPZ)));
+            colors[0] *= c.r;
+            colors[1] *= c.g;
+            colors[2] *= c.b;
+            colors[3] *= c.a;
+        }
+    }
 
-    if(dest->texture())
+    /** find how much to scale the colors of triangleCount triangles by : ambient plus diffuse times how much each triangle faces lightDir.
+     * this is separate from scaling the colors so the callers can throw for degenerate triangles before changing anything
+     */
+    static vector<float> lightBrightness(const float *points, size_t triangleCount, VectorF lightDir, float ambient, float diffuse)
     {
-        if(mesh->texture() && mesh->texture() != dest->texture())
+        vector<float> brightness(triangleCount);
+        bool degenerate = false;
+        for(size_t i = 0; i < triangleCount; i++)
+        {
+            const float *p = points + floatsPerPoint * pointsPerTriangle * i;
+            float ax = p[3] - p[0], ay = p[4] - p[1], az = p[5] - p[2];
+            float bx = p[6] - p[0], by = p[7] - p[1], bz = p[8] - p[2];
+            float nx = ay * bz - az * by, ny = az * bx - ax * bz, nz = ax * by - ay * bx;
+            float lengthSquared = nx * nx + ny * ny + nz * nz;
+            degenerate |= (lengthSquared == 0);
+            float v = (nx * lightDir.x + ny * lightDir.y + nz * lightDir.z) / sqrt(lengthSquared);
+            brightness[i] = max(v, 0.0f) * diffuse + ambient;
+        }
+        if(degenerate)
         {
-            throw ImageNotSameException();
+            throw domain_error("can't normalize <0, 0, 0>");
         }
+        return brightness;
     }
-    else
+
+    /// scale the colors of each triangle by its brightness from lightBrightness
+    static void lightColorArrays(float *colors, const vector<float> &brightness)
     {
-        dest->textureInternal = mesh->texture();
+        for(float v : brightness)
+        {
+            for(size_t j = 0; j < colorsPerTriangle; j++, colors += floatsPerColor)
+            {
+                colors[0] *= v;
+                colors[1] *= v;
+                colors[2] *= v;
+            }
+        }
     }
 
-    dest->length += mesh->length;
-    dest->textureCoords.insert(dest->textureCoords.end(), mesh->textureCoords.begin(), mesh->textureCoords.end());
-    size_t vi = 0, ci = 0;
-    for(size_t i = 0; i < mesh->length; i++)
+    /// add mesh to the end of dest
+    /// @return the index of the first added triangle
+    static size_t append(Mesh dest, Mesh &mesh)
     {
-        float x = mesh->points[vi++];
-        float y = mesh->points[vi++];
-        float z = mesh->points[vi++];
-        dest->points.push_back(x);
-        dest->points.push_back(y);
-        dest->points.push_back(z);
-        Color c;
-        c.r = mesh->colors[ci++];
-        c.g = mesh->colors[ci++];
-        c.b = mesh->colors[ci++];
-        c.a = mesh->colors[ci++];
-        c = scale(c, interpolate(x, interpolate(y, interpolate(z, cNXNYNZ, cNXNYPZ), interpolate(z, cNXPYNZ, cNXPYPZ)), interpolate(y, interpolate(z, cPXNYNZ, cPXNYPZ), interpolate(z, cPXPYNZ, cPXPYPZ))));
-        dest->colors.push_back(c.r);
-        dest->colors.push_back(c.g);
-        dest->colors.push_back(c.b);
-        dest->colors.push_back(c.a);
+        if(dest == mesh)
+        {
+            mesh = Mesh(new Mesh_t(*mesh));
+        }
+        size_t retval = dest->length;
+        dest->add(*mesh);
+        return retval;
     }
+public:
+    friend Mesh interpolateColors(Mesh dest, Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ);
+    friend Mesh interpolateColors(Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ);
+    friend Mesh interpolateColorsInPlace(Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ);
+    friend Mesh lightColors(Mesh dest, Mesh mesh, VectorF lightDir, float ambient, float diffuse);
+    friend Mesh lightColors(Mesh mesh, VectorF lightDir, float ambient, float diffuse);
+    friend Mesh lightColorsInPlace(Mesh mesh, VectorF lightDir, float ambient, float diffuse);
+};
+
+/// add mesh to dest with its colors scaled by the corner colors of the unit box, interpolated at each point
+inline Mesh interpolateColors(Mesh dest, Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ)
+{
+    assert(dest && mesh);
+    size_t start = Mesh_t::append(dest, mesh);
+    Mesh_t::interpolateColorArrays(dest->points.data() + Mesh_t::floatsPerPoint * Mesh_t::pointsPerTriangle * start,
+                                   dest->colors.data() + Mesh_t::floatsPerColor * Mesh_t::colorsPerTriangle * start,
+                                   Mesh_t::pointsPerTriangle * mesh->length,
+                                   cNXNYNZ, cNXNYPZ, cNXPYNZ, cNXPYPZ, cPXNYNZ, cPXNYPZ, cPXPYNZ, cPXPYPZ);
     return dest;
 }
 
+/// @return a copy of mesh with its colors scaled by the corner colors of the unit box, interpolated at each point
 inline Mesh interpolateColors(Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ)
 {
     assert(mesh);
-    Mesh dest = Mesh(new Mesh_t);
-
-    dest->textureInternal = mesh->texture();
-
-    dest->length += mesh->length;
-    dest->textureCoords.insert(dest->textureCoords.end(), mesh->textureCoords.begin(), mesh->textureCoords.end());
-    size_t vi = 0, ci = 0;
-    for(size_t i = 0; i < mesh->length; i++)
-    {
-        float x = mesh->points[vi++];
-        float y = mesh->points[vi++];
-        float z = mesh->points[vi++];
-        dest->points.push_back(x);
-        dest->points.push_back(y);
-        dest->points.push_back(z);
-        Color c;
-        c.r = mesh->colors[ci++];
-        c.g = mesh->colors[ci++];
-        c.b = mesh->colors[ci++];
-        c.a = mesh->colors[ci++];
-        c = scale(c, interpolate(x, interpolate(y, interpolate(z, cNXNYNZ, cNXNYPZ), interpolate(z, cNXPYNZ, cNXPYPZ)), interpolate(y, interpolate(z, cPXNYNZ, cPXNYPZ), interpolate(z, cPXPYNZ, cPXPYPZ))));
-        dest->colors.push_back(c.r);
-        dest->colors.push_back(c.g);
-        dest->colors.push_back(c.b);
-        dest->colors.push_back(c.a);
-    }
+    return interpolateColorsInPlace(Mesh(new Mesh_t(*mesh)), cNXNYNZ, cNXNYPZ, cNXPYNZ, cNXPYPZ, cPXNYNZ, cPXNYPZ, cPXPYNZ, cPXPYPZ);
+}
+
+/// scale the colors of mesh by the corner colors of the unit box, interpolated at each point
+/// @return mesh
+inline Mesh interpolateColorsInPlace(Mesh mesh, Color cNXNYNZ, Color cNXNYPZ, Color cNXPYNZ, Color cNXPYPZ, Color cPXNYNZ, Color cPXNYPZ, Color cPXPYNZ, Color cPXPYPZ)
+{
+    assert(mesh);
+    mesh->invalidate();
+    Mesh_t::interpolateColorArrays(mesh->points.data(), mesh->colors.data(), Mesh_t::pointsPerTriangle * mesh->length,
+                                   cNXNYNZ, cNXNYPZ, cNXPYNZ, cNXPYPZ, cPXNYNZ, cPXNYPZ, cPXPYNZ, cPXPYPZ);
+    return mesh;
+}
+
+/// add mesh to dest with each triangle's colors scaled by ambient plus diffuse times how much it faces lightDir
+inline Mesh lightColors(Mesh dest, Mesh mesh, VectorF lightDir, float ambient, float diffuse)
+{
+    assert(dest && mesh);
+    vector<float> brightness = Mesh_t::lightBrightness(mesh->points.data(), mesh->length, lightDir, ambient, diffuse);
+    size_t start = Mesh_t::append(dest, mesh);
+    Mesh_t::lightColorArrays(dest->colors.data() + Mesh_t::floatsPerColor * Mesh_t::colorsPerTriangle * start, brightness);
     return dest;
 }
 
+/// @return a copy of mesh with each triangle's colors scaled by ambient plus diffuse times how much it faces lightDir
 inline Mesh lightColors(Mesh mesh, VectorF lightDir, float ambient, float diffuse)
 {
-    vector<Triangle> triangles;
-    triangles.reserve(mesh->size());
-    for(Triangle t : *mesh)
-    {
-        float v = dot(t.normal(), lightDir);
-        if(v < 0)
-            v = 0;
-        v *= diffuse;
-        v += ambient;
-        t.c[0] = scale(t.c[0], v);
-        t.c[1] = scale(t.c[1], v);
-        t.c[2] = scale(t.c[2], v);
-        triangles.push_back(t);
-    }
-    return Mesh(new Mesh_t(mesh->texture(), triangles));
+    assert(mesh);
+    return lightColorsInPlace(Mesh(new Mesh_t(*mesh)), lightDir, ambient, diffuse);
+}
+
+/// scale each triangle's colors by ambient plus diffuse times how much it faces lightDir
+/// @return mesh
+inline Mesh lightColorsInPlace(Mesh mesh, VectorF lightDir, float ambient, float diffuse)
+{
+    assert(mesh);
+    vector<float> brightness = Mesh_t::lightBrightness(mesh->points.data(), mesh->length, lightDir, ambient, diffuse);
+    mesh->invalidate();
+    Mesh_t::lightColorArrays(mesh->colors.data(), brightness);
+    return mesh;
 }
 
 inline TransformedMesh::operator Mesh() const
@@ -561,11 +788,37 @@ inline TransformedMesh::operator Mesh() const
     return Mesh(new Mesh_t(*this));
 }
 
+/** build a mesh out of independent parts on the job system's threads.
+ * the parts are split into ranges that are each built into their own Mesh_t and then merged in order,
+ * so the result is the same as adding all the parts to one mesh.
+ *
+ * @param partCount the number of parts
+ * @param makePart called as makePart(index, dest) to add part index to dest. it's called from several threads at once.
+ * @param jobs the job system to build with
+ * @return the new mesh
+ */
+inline Mesh buildMesh(size_t partCount, function<void(size_t index, Mesh_t &dest)> makePart, JobSystem &jobs = JobSystem::global())
+{
+    vector<Mesh_t> buffers(max<size_t>(1, min(partCount, jobs.defaultChunkCount())));
+    jobs.parallelForRanges(partCount, buffers.size(), [&](size_t chunk, size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            makePart(i, buffers[chunk]);
+        }
+    });
+    if(buffers.size() == 1)
+        return Mesh(new Mesh_t(move(buffers[0])));
+    return Mesh_t::merge(buffers, jobs);
+}
+
 class Renderer final
 {
 private:
     Renderer(const Renderer &) = delete;
     const Renderer operator =(const Renderer &) = delete;
+    static bool bindBufferObject(const Mesh_t &m, bool uploadNow = false);
+    static void setArrayPointers(const Mesh_t &m, bool fromBufferObject);
 public:
     Renderer()
     {
@@ -583,12 +836,16 @@ public:
         return *this;
     }
 
-    Renderer &operator <<(TransformedMesh m)
-    {
-        Mesh_t m2(m);
-        operator <<(m2);
-        return *this;
-    }
+    /// draw a transformed mesh. single meshes are not culled, draw a batch to skip meshes outside of the view frustum
+    Renderer &operator <<(TransformedMesh m);
+
+    /** draw a batch of meshes. Instances sharing the same Mesh are drawn from one buffer object,
+     * changing only the modelview matrix between them, instead of transforming every vertex on the CPU.
+     * meshes outside of the view frustum are skipped.
+     *
+     * @param meshes the meshes to draw
+     */
+    Renderer &operator <<(const vector<TransformedMesh> &meshes);
 };
 
 #endif // MESH_H_INCLUDED
@@ -56,6 +56,12 @@ public:
         if(buffer.size() >= 16384)
             flush();
     }
+    virtual void writeBytes(const uint8_t * array, size_t count)
+    {
+        buffer.insert(buffer.end(), array, array + count);
+        if(buffer.size() >= 16384)
+            flush();
+    }
     virtual void flush()
     {
         const uint8_t * pbuffer = buffer.data();
@@ -13,6 +13,7 @@ class OggVorbisDecoder final : public AudioDecoder
 private:
     OggVorbis_File ovf;
     shared_ptr<Reader> reader;
+    MemoryReader * memoryReader;
     uint64_t samples;
     unsigned channels;
     unsigned sampleRate;
@@ -22,10 +23,20 @@ private:
     static size_t read_fn(void * dataPtr_in, size_t blockSize, size_t numBlocks, void * dataSource)
     {
         OggVorbisDecoder & decoder = *(OggVorbisDecoder *)dataSource;
+        if(blockSize == 0)
+            return 0;
         size_t readCount = 0;
         try
         {
             uint8_t * dataPtr = (uint8_t *)dataPtr_in;
+            if(blockSize == 1)
+            {
+                while(readCount < numBlocks)
+                {
+                    readCount += decoder.reader->readUpTo(dataPtr + readCount, numBlocks - readCount);
+                }
+                return readCount;
+            }
             for(size_t i = 0; i < numBlocks; i++, readCount++)
             {
                 decoder.reader->readBytes(dataPtr, blockSize);
@@ -43,6 +54,35 @@ private:
         }
         return readCount;
     }
+    static int seek_fn(void * dataSource, ogg_int64_t offset, int whence)
+    {
+        OggVorbisDecoder & decoder = *(OggVorbisDecoder *)dataSource;
+        MemoryReader & reader = *decoder.memoryReader;
+        ogg_int64_t base = 0;
+        switch(whence)
+        {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = reader.tell();
+            break;
+        case SEEK_END:
+            base = reader.size();
+            break;
+        default:
+            return -1;
+        }
+        if(offset < -base || base + offset > (ogg_int64_t)reader.size())
+            return -1;
+        reader.seek(base + offset);
+        return 0;
+    }
+    static long tell_fn(void * dataSource)
+    {
+        OggVorbisDecoder & decoder = *(OggVorbisDecoder *)dataSource;
+        return decoder.memoryReader->tell();
+    }
     inline void readBuffer()
     {
         buffer.resize(buffer.capacity());
@@ -59,13 +99,18 @@ private:
     }
 public:
     OggVorbisDecoder(shared_ptr<Reader> reader)
-        : reader(reader)
+        : reader(reader), memoryReader(dynamic_cast<MemoryReader *>(reader.get()))
     {
         ov_callbacks callbacks;
         callbacks.read_func = &read_fn;
         callbacks.seek_func = nullptr;
         callbacks.close_func = nullptr;
         callbacks.tell_func = nullptr;
+        if(memoryReader != nullptr) // seekable, so vorbisfile can find the length
+        {
+            callbacks.seek_func = &seek_fn;
+            callbacks.tell_func = &tell_fn;
+        }
         int openRetval = ov_open_callbacks((void *)this, &ovf, NULL, 0, callbacks);
         switch(openRetval)
         {
@@ -0,0 +1,49 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#define GL_GLEXT_PROTOTYPES
+#include "packed_mesh.h"
+#include "platform.h"
+#include <cstddef>
+
+Renderer & operator <<(Renderer & renderer, const PackedMesh_t & m)
+{
+    if(m.size() == 0)
+        return renderer;
+    m.texture().bind();
+    bool needsUpload;
+    bool fromBufferObject = m.bufferObject.bind(false, needsUpload);
+    if(needsUpload)
+        glBufferData(GL_ARRAY_BUFFER, m.byteSize(), (const void *)m.vertices.data(), GL_STATIC_DRAW);
+    const char * base = (fromBufferObject ? nullptr : (const char *)m.vertices.data());
+    const GLsizei stride = sizeof(PackedVertex);
+    glVertexPointer(3, GL_FLOAT, stride, (const void *)(base + offsetof(PackedVertex, x)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, stride, (const void *)(base + offsetof(PackedVertex, r)));
+    glTexCoordPointer(2, GL_SHORT, stride, (const void *)(base + offsetof(PackedVertex, u)));
+    GLint matrixMode;
+    glGetIntegerv(GL_MATRIX_MODE, &matrixMode);
+    glMatrixMode(GL_TEXTURE);
+    glPushMatrix(); // fixed function doesn't normalize short texture coordinates so unpack them with the texture matrix
+    glTranslatef(m.minU + m.scaleU * PackedMesh_t::packedTextureCoordOffset, m.minV + m.scaleV * PackedMesh_t::packedTextureCoordOffset, 0);
+    glScalef(m.scaleU, m.scaleV, 1);
+    glDrawArrays(GL_TRIANGLES, 0, (GLint)m.vertices.size());
+    glPopMatrix();
+    glMatrixMode((GLenum)matrixMode);
+    if(fromBufferObject)
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return renderer;
+}
@@ -0,0 +1,312 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef PACKED_MESH_H_INCLUDED
+#define PACKED_MESH_H_INCLUDED
+
+#include "mesh.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/// one interleaved vertex of a PackedMesh_t : 20 bytes instead of the 36 bytes used by Mesh_t
+struct PackedVertex final
+{
+    float x, y, z;
+    uint8_t r, g, b, a;
+    int16_t u, v; /// normalized to the texture coordinate range of the mesh
+};
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex is not packed");
+
+class PackedMesh_t;
+
+typedef shared_ptr<PackedMesh_t> PackedMesh;
+
+/** a compact mesh with interleaved vertices, RGBA8 colors and 16-bit texture coordinates.
+ * texture coordinates are quantized over the range that the mesh uses so any range keeps 16 bits of precision.
+ */
+class PackedMesh_t final
+{
+    friend Renderer &operator <<(Renderer &renderer, const PackedMesh_t &m);
+private:
+    vector<PackedVertex> vertices;
+    Image textureInternal;
+    float minU = 0, minV = 0, scaleU = 0, scaleV = 0;
+    mutable MeshBufferObject bufferObject;
+    static constexpr size_t verticesPerTriangle = 3;
+    static constexpr int32_t packedTextureCoordOffset = 32768;
+    static float getScale(float minValue, float maxValue)
+    {
+        return (maxValue - minValue) / 65535;
+    }
+    static int16_t packTextureCoord(float value, float minValue, float scale)
+    {
+        if(scale == 0)
+            return (int16_t)-packedTextureCoordOffset;
+        return (int16_t)(limit<int32_t>((int32_t)floor((value - minValue) / scale + 0.5f), 0, 65535) - packedTextureCoordOffset);
+    }
+    static float unpackTextureCoord(int16_t value, float minValue, float scale)
+    {
+        return minValue + scale * ((int32_t)value + packedTextureCoordOffset);
+    }
+    PackedVertex packVertex(VectorF p, Color c, TextureCoord t) const
+    {
+        PackedVertex retval;
+        retval.x = p.x;
+        retval.y = p.y;
+        retval.z = p.z;
+        retval.r = c.ri();
+        retval.g = c.gi();
+        retval.b = c.bi();
+        retval.a = c.ai();
+        retval.u = packTextureCoord(t.u, minU, scaleU);
+        retval.v = packTextureCoord(t.v, minV, scaleV);
+        return retval;
+    }
+public:
+    PackedMesh_t()
+    {
+    }
+
+    template <typename Iterator>
+    PackedMesh_t(Image texture, Iterator trianglesBegin, Iterator trianglesEnd)
+        : textureInternal(texture)
+    {
+        float maxU = 0, maxV = 0;
+        bool first = true;
+        for(Iterator i = trianglesBegin; i != trianglesEnd; ++i)
+        {
+            const Triangle &tri = *i;
+            for(TextureCoord t : tri.t)
+            {
+                if(first || t.u < minU)
+                    minU = t.u;
+                if(first || t.v < minV)
+                    minV = t.v;
+                if(first || t.u > maxU)
+                    maxU = t.u;
+                if(first || t.v > maxV)
+                    maxV = t.v;
+                first = false;
+            }
+        }
+        scaleU = getScale(minU, maxU);
+        scaleV = getScale(minV, maxV);
+        for(Iterator i = trianglesBegin; i != trianglesEnd; ++i)
+        {
+            const Triangle &tri = *i;
+            for(size_t j = 0; j < verticesPerTriangle; j++)
+            {
+                vertices.push_back(packVertex(tri.p[j], tri.c[j], tri.t[j]));
+            }
+        }
+    }
+
+    PackedMesh_t(Image texture, const vector<Triangle> &triangles)
+        : PackedMesh_t(texture, triangles.begin(), triangles.end())
+    {
+    }
+
+    explicit PackedMesh_t(const Mesh_t &mesh)
+        : PackedMesh_t(mesh.texture(), mesh.begin(), mesh.end())
+    {
+    }
+
+    const Image &texture() const
+    {
+        return textureInternal;
+    }
+
+    size_t size() const
+    {
+        return vertices.size() / verticesPerTriangle;
+    }
+
+    /// @return the size of the vertex data in bytes
+    size_t byteSize() const
+    {
+        return vertices.size() * sizeof(PackedVertex);
+    }
+
+    Triangle getTriangle(size_t index) const
+    {
+        Triangle retval;
+        for(size_t j = 0; j < verticesPerTriangle; j++)
+        {
+            const PackedVertex &v = vertices[index * verticesPerTriangle + j];
+            retval.p[j] = VectorF(v.x, v.y, v.z);
+            retval.c[j].ri(v.r);
+            retval.c[j].gi(v.g);
+            retval.c[j].bi(v.b);
+            retval.c[j].ai(v.a);
+            retval.t[j] = TextureCoord(unpackTextureCoord(v.u, minU, scaleU), unpackTextureCoord(v.v, minV, scaleV));
+        }
+        return retval;
+    }
+
+    friend class const_iterator;
+    class const_iterator final : public iterator<random_access_iterator_tag, const Triangle, ssize_t>
+    {
+        friend class PackedMesh_t;
+    private:
+        const PackedMesh_t *mesh;
+        size_t index;
+        mutable Triangle tri;
+        const_iterator(const PackedMesh_t *mesh, size_t index)
+            : mesh(mesh), index(index)
+        {
+        }
+    public:
+        const_iterator()
+            : mesh(nullptr), index(0)
+        {
+        }
+        bool operator ==(const const_iterator &rt) const
+        {
+            return index == rt.index;
+        }
+        bool operator !=(const const_iterator &rt) const
+        {
+            return index != rt.index;
+        }
+        const Triangle &operator *() const
+        {
+            tri = mesh->getTriangle(index);
+            return tri;
+        }
+        const Triangle &operator[](ssize_t i) const
+        {
+            tri = mesh->getTriangle(index + i);
+            return tri;
+        }
+        const Triangle *operator ->() const
+        {
+            return &operator *();
+        }
+        const_iterator operator +(ssize_t i) const
+        {
+            return const_iterator(mesh, index + i);
+        }
+        friend const_iterator operator +(ssize_t i, const const_iterator &iter)
+        {
+            return iter.operator + (i);
+        }
+        const_iterator operator -(ssize_t i) const
+        {
+            return operator +(-i);
+        }
+        ssize_t operator -(const const_iterator &r) const
+        {
+            return (ssize_t)index - (ssize_t)r.index;
+        }
+        const const_iterator &operator +=(ssize_t i)
+        {
+            index += i;
+            return *this;
+        }
+        const const_iterator &operator -=(ssize_t i)
+        {
+            index -= i;
+            return *this;
+        }
+        const const_iterator &operator ++()
+        {
+            return operator +=(1);
+        }
+        const const_iterator &operator --()
+        {
+            return operator -=(1);
+        }
+        const_iterator operator ++(int)
+        {
+            const_iterator retval = *this;
+            operator ++();
+            return retval;
+        }
+        const_iterator operator --(int)
+        {
+            const_iterator retval = *this;
+            operator --();
+            return retval;
+        }
+        bool operator >(const const_iterator &r) const
+        {
+            return index > r.index;
+        }
+        bool operator >=(const const_iterator &r) const
+        {
+            return index >= r.index;
+        }
+        bool operator <(const const_iterator &r) const
+        {
+            return index < r.index;
+        }
+        bool operator <=(const const_iterator &r) const
+        {
+            return index <= r.index;
+        }
+    };
+
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, size());
+    }
+
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    /// @return the mesh converted back to the Mesh_t layout
+    Mesh unpack() const
+    {
+        return Mesh(new Mesh_t(texture(), vector<Triangle>(begin(), end())));
+    }
+};
+
+Renderer &operator <<(Renderer &renderer, const PackedMesh_t &m);
+
+inline Renderer &operator <<(Renderer &renderer, PackedMesh m)
+{
+    return renderer << *m;
+}
+
+#endif // PACKED_MESH_H_INCLUDED
@@ -28,6 +28,9 @@
 #include <functional>
 #include <iostream>
 #include <cmath>
+#include <array>
+#include <chrono>
+#include <thread>
 
 using namespace std;
 
@@ -128,6 +131,67 @@ public:
     bool isSupportedBy(const PhysicsObject & rt) const;
 };
 
+/// the state of a PhysicsObject as published in a PhysicsSnapshot
+struct PhysicsObjectState final
+{
+    PositionF position;
+    VectorF velocity;
+    VectorF extents;
+    bool isStatic, isSupported, isCylinder;
+};
+
+/// the states of all the objects in a PhysicsWorld at the end of the last two runs, for renderers to interpolate between
+class PhysicsSnapshot final
+{
+    friend class PhysicsWorld;
+private:
+    struct Entry final
+    {
+        PositionF previousPosition;
+        PhysicsObjectState state;
+    };
+    double previousTime = 0, currentTime = 0;
+    double previousRealTime = 0, currentRealTime = 0;
+    unordered_map<intptr_t, Entry> objects;
+public:
+    static double realTime()
+    {
+        return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    /** @return how far to interpolate between the previous and the current states for smooth motion :
+     * the snapshot is displayed one publishing interval behind the simulation
+     */
+    float getInterpolationFactor() const
+    {
+        double interval = currentRealTime - previousRealTime;
+        if(interval <= 0)
+            return 1;
+        return limit<float>((realTime() - currentRealTime) / interval, 0, 1);
+    }
+    double getTime(float t = 1) const
+    {
+        return previousTime + t * (currentTime - previousTime);
+    }
+    /** get the interpolated state of an object
+     *
+     * @param object the object to look up
+     * @param t the interpolation factor
+     * @param state the interpolated state
+     * @return if the object is in this snapshot
+     */
+    bool getState(shared_ptr<PhysicsObject> object, float t, PhysicsObjectState & state) const
+    {
+        auto iter = objects.find((intptr_t)object.get());
+        if(iter == objects.end())
+            return false;
+        const Entry & entry = get<1>(*iter);
+        state = entry.state;
+        if(entry.previousPosition.d == state.position.d)
+            state.position = PositionF(interpolate<VectorF>(t, (VectorF)entry.previousPosition, (VectorF)state.position), state.position.d);
+        return true;
+    }
+};
+
 class PhysicsWorld final : public enable_shared_from_this<PhysicsWorld>
 {
     friend class PhysicsObject;
@@ -204,12 +268,103 @@ private:
     {
         variableSetIndex = (variableSetIndex != 0 ? 0 : 1);
     }
+    double lag = 0;
+    void runStep(double newTime, size_t collisionIterations);
+    TripleBuffer<PhysicsSnapshot> snapshots;
+    unordered_map<intptr_t, PositionF> publishedPositions;
+    double publishedTime = 0, publishedRealTime = 0;
+    void publishSnapshot();
 public:
     void runToTime(double stopTime);
+    /** run the simulation towards <code>stopTime</code> without spending more than <code>timeBudget</code> seconds of real time
+     *
+     * @param stopTime the simulation time to run to
+     * @param timeBudget the maximum real time to spend, in seconds. At least one step is always run.
+     * @param allowApproximation if the simulation is far behind, use longer steps and fewer collision iterations to catch up
+     * @return the simulation time that is still left to run
+     */
+    double runToTime(double stopTime, double timeBudget, bool allowApproximation = true);
     void stepTime(double deltaTime)
     {
         runToTime(deltaTime + getCurrentTime());
     }
+    /** advance the simulation by <code>deltaTime</code> plus any lag left over from previous calls, limited by a real time budget.
+     * lag beyond <code>maximumLag</code> seconds is dropped so the simulation slows down instead of falling further behind.
+     *
+     * @param deltaTime the simulation time to add
+     * @param timeBudget the maximum real time to spend, in seconds
+     * @param allowApproximation if the simulation is far behind, use longer steps and fewer collision iterations to catch up
+     * @return the simulation lag after running
+     */
+    double stepTime(double deltaTime, double timeBudget, bool allowApproximation = true)
+    {
+        constexpr double maximumLag = 0.25;
+        lag = min(lag + deltaTime, maximumLag);
+        lag = runToTime(currentTime + lag, timeBudget, allowApproximation);
+        return lag;
+    }
+    /// @return the simulation time that the last time-budgeted <code>stepTime</code> couldn't run
+    double getLag() const
+    {
+        return lag;
+    }
+    /** get the latest snapshot, published at the end of every run. This doesn't block and can be called
+     * while another thread is running the simulation, but only from one thread at a time.
+     *
+     * @return the latest snapshot. it stays valid until the next call.
+     */
+    const PhysicsSnapshot & getSnapshot()
+    {
+        snapshots.update();
+        return snapshots.readBuffer();
+    }
+};
+
+/** runs a PhysicsWorld in real time on its own thread.
+ * create all the objects before starting it and only use snapshots to read the world while it's running.
+ */
+class PhysicsWorldThread final
+{
+public:
+    /// called on the physics thread with how long each step took
+    typedef function<void(chrono::steady_clock::duration stepTime)> StepTimer;
+private:
+    shared_ptr<PhysicsWorld> world;
+    StepTimer stepTimer;
+    atomic_bool done;
+    thread workerThread;
+    PhysicsWorldThread(const PhysicsWorldThread &) = delete;
+    const PhysicsWorldThread & operator =(const PhysicsWorldThread &) = delete;
+    void run(double stepInterval)
+    {
+        typedef chrono::steady_clock clock;
+        const clock::duration interval = chrono::duration_cast<clock::duration>(chrono::duration<double>(stepInterval));
+        clock::time_point lastTime = clock::now();
+        while(!done)
+        {
+            this_thread::sleep_until(lastTime + interval);
+            clock::time_point now = clock::now();
+            double deltaTime = chrono::duration<double>(now - lastTime).count();
+            lastTime = now;
+            world->stepTime(deltaTime, stepInterval);
+            if(stepTimer)
+                stepTimer(clock::now() - now);
+        }
+    }
+public:
+    explicit PhysicsWorldThread(shared_ptr<PhysicsWorld> world, double stepInterval = 1 / 120.0, StepTimer stepTimer = nullptr)
+        : world(world), stepTimer(stepTimer), done(false)
+    {
+        workerThread = thread([this, stepInterval]()
+        {
+            run(stepInterval);
+        });
+    }
+    ~PhysicsWorldThread()
+    {
+        done = true;
+        workerThread.join();
+    }
 };
 
 inline PhysicsObject::PhysicsObject(PositionF position, VectorF velocity, bool affectedByGravity, bool isStatic, VectorF extents, shared_ptr<PhysicsWorld> world, PhysicsProperties properties, bool isCylinder)
@@ -360,198 +515,239 @@ inline void PhysicsWorld::runToTime(double stopTime)
     for(size_t i = 1; i <= stepCount; i++)
     {
         if(i >= stepCount)
-            currentTime = stopTime;
+            runStep(stopTime, 10);
+        else
+            runStep(currentTime + stepDuration, 10);
+    }
+    publishSnapshot();
+}
+
+inline double PhysicsWorld::runToTime(double stopTime, double timeBudget, bool allowApproximation)
+{
+    typedef chrono::steady_clock clock;
+    constexpr double stepDuration = 1 / 600.0, approximateStepDuration = 1 / 150.0;
+    constexpr size_t collisionIterations = 10, approximateCollisionIterations = 3;
+    constexpr double approximationLagThreshold = 1 / 30.0;
+    const clock::time_point deadline = clock::now() + chrono::duration_cast<clock::duration>(chrono::duration<double>(timeBudget));
+    while(stopTime - currentTime > timeEPS)
+    {
+        double remainingTime = stopTime - currentTime;
+        double duration = stepDuration;
+        size_t iterations = collisionIterations;
+        if(allowApproximation && remainingTime > approximationLagThreshold)
+        {
+            duration = approximateStepDuration;
+            iterations = approximateCollisionIterations;
+        }
+        if(remainingTime <= duration * (1 + timeEPS))
+            runStep(stopTime, iterations);
         else
-            currentTime += stepDuration;
-        bool anyCollisions = true;
-        for(size_t i = 0; i < 10 && anyCollisions; i++)
-        {
-            anyCollisions = false;
-            vector<shared_ptr<PhysicsObject>> objectsVector(objects.begin(), objects.end());
-            vector<pair<float, shared_ptr<PhysicsObject>>> temporaryObjectsVector;
-            temporaryObjectsVector.resize(objectsVector.size());
-            for(size_t i = 0; i < temporaryObjectsVector.size(); i++)
-                temporaryObjectsVector[i] = make_pair(objectsVector[i]->getPosition().y - objectsVector[i]->getExtents().y, objectsVector[i]);
-            sort(temporaryObjectsVector.begin(), temporaryObjectsVector.end(), [](pair<float, shared_ptr<PhysicsObject>> a, pair<float, shared_ptr<PhysicsObject>> b)
+            runStep(currentTime + duration, iterations);
+        if(clock::now() >= deadline)
+            break;
+    }
+    publishSnapshot();
+    return max(0.0, stopTime - currentTime);
+}
+
+inline void PhysicsWorld::publishSnapshot()
+{
+    PhysicsSnapshot & snapshot = snapshots.writeBuffer();
+    snapshot.currentTime = currentTime;
+    snapshot.currentRealTime = PhysicsSnapshot::realTime();
+    snapshot.previousTime = (publishedRealTime > 0 ? publishedTime : snapshot.currentTime);
+    snapshot.previousRealTime = (publishedRealTime > 0 ? publishedRealTime : snapshot.currentRealTime);
+    publishedTime = snapshot.currentTime;
+    publishedRealTime = snapshot.currentRealTime;
+    snapshot.objects.clear();
+    unordered_map<intptr_t, PositionF> newPublishedPositions;
+    newPublishedPositions.reserve(objects.size());
+    for(shared_ptr<PhysicsObject> o : objects)
+    {
+        if(!o || o->isDestroyed())
+            continue;
+        PhysicsSnapshot::Entry entry;
+        entry.state.position = o->getPosition();
+        entry.state.velocity = o->getVelocity();
+        entry.state.extents = o->getExtents();
+        entry.state.isStatic = o->isStatic();
+        entry.state.isSupported = o->isSupported();
+        entry.state.isCylinder = o->isCylinder();
+        entry.previousPosition = entry.state.position;
+        auto iter = publishedPositions.find((intptr_t)o.get());
+        if(iter != publishedPositions.end())
+            entry.previousPosition = get<1>(*iter);
+        snapshot.objects[(intptr_t)o.get()] = entry;
+        newPublishedPositions[(intptr_t)o.get()] = entry.state.position;
+    }
+    publishedPositions = std::move(newPublishedPositions);
+    snapshots.publish();
+}
+
+inline void PhysicsWorld::runStep(double newTime, size_t collisionIterations)
+{
+    currentTime = newTime;
+    bool anyCollisions = true;
+    for(size_t i = 0; i < collisionIterations && anyCollisions; i++)
+    {
+        anyCollisions = false;
+        vector<shared_ptr<PhysicsObject>> objectsVector(objects.begin(), objects.end());
+        vector<pair<float, shared_ptr<PhysicsObject>>> temporaryObjectsVector;
+        temporaryObjectsVector.resize(objectsVector.size());
+        for(size_t i = 0; i < temporaryObjectsVector.size(); i++)
+            temporaryObjectsVector[i] = make_pair(objectsVector[i]->getPosition().y - objectsVector[i]->getExtents().y, objectsVector[i]);
+        sort(temporaryObjectsVector.begin(), temporaryObjectsVector.end(), [](pair<float, shared_ptr<PhysicsObject>> a, pair<float, shared_ptr<PhysicsObject>> b)
+        {
+            return get<0>(a) < get<0>(b);
+        });
+        for(size_t i = 0; i < temporaryObjectsVector.size(); i++)
+            objectsVector[i] = get<1>(temporaryObjectsVector[i]);
+        for(auto i = objectsVector.begin(); i != objectsVector.end(); i++)
+        {
+            shared_ptr<PhysicsObject> objectA = *i;
+            if(!objectA || objectA->isDestroyed())
+                continue;
+            objectA->position[getOldVariableSetIndex()] = objectA->getPosition();
+            objectA->velocity[getOldVariableSetIndex()] = objectA->getVelocity();
+            objectA->objectTime[getOldVariableSetIndex()] = currentTime;
+            objectA->supported = false;
+            if(objectA->isStatic())
             {
-                return get<0>(a) < get<0>(b);
-            });
-            for(size_t i = 0; i < temporaryObjectsVector.size(); i++)
-                objectsVector[i] = get<1>(temporaryObjectsVector[i]);
-            for(auto i = objectsVector.begin(); i != objectsVector.end(); i++)
+                objectA->supported = true;
+                continue;
+            }
+            for(auto j = objectsVector.begin(); j != i; j++)
             {
-                shared_ptr<PhysicsObject> objectA = *i;
-                if(!objectA || objectA->isDestroyed())
+                shared_ptr<PhysicsObject> objectB = *j;
+                if(!objectB || objectB->isDestroyed())
                     continue;
-                objectA->position[getOldVariableSetIndex()] = objectA->getPosition();
-                objectA->velocity[getOldVariableSetIndex()] = objectA->getVelocity();
-                objectA->objectTime[getOldVariableSetIndex()] = currentTime;
-                objectA->supported = false;
-                if(objectA->isStatic())
+                bool supported = objectA->isSupportedBy(*objectB);
+                if(supported)
                 {
                     objectA->supported = true;
-                    continue;
-                }
-                for(auto j = objectsVector.begin(); j != i; j++)
-                {
-                    shared_ptr<PhysicsObject> objectB = *j;
-                    if(!objectB || objectB->isDestroyed())
-                        continue;
-                    bool supported = objectA->isSupportedBy(*objectB);
-                    if(supported)
-                    {
-                        objectA->supported = true;
-                    }
                 }
             }
-            constexpr size_t xScaleFactor = 5, zScaleFactor = 5;
-            constexpr size_t bigHashPrime = 14713, smallHashPrime = 91;
-            struct HashNode final
+        }
+        constexpr size_t xScaleFactor = 5, zScaleFactor = 5;
+        constexpr size_t bigHashPrime = 14713, smallHashPrime = 91;
+        struct HashNode final
+        {
+            HashNode * hashNext;
+            int x, z;
+            shared_ptr<PhysicsObject> object;
+        };
+        array<HashNode *, bigHashPrime> overallHashTable;
+        overallHashTable.fill(nullptr);
+        static thread_local HashNode * freeListHead = nullptr;
+        vector<shared_ptr<PhysicsObject>> collideObjectsList;
+        collideObjectsList.reserve(objects.size());
+        for(auto i = objects.begin(); i != objects.end();)
+        {
+            shared_ptr<PhysicsObject> o = *i;
+            if(!o || o->isDestroyed())
             {
-                HashNode * hashNext;
-                int x, z;
-                shared_ptr<PhysicsObject> object;
-            };
-            array<HashNode *, bigHashPrime> overallHashTable;
-            overallHashTable.fill(nullptr);
-            static thread_local HashNode * freeListHead = nullptr;
-            vector<shared_ptr<PhysicsObject>> collideObjectsList;
-            collideObjectsList.reserve(objects.size());
-            for(auto i = objects.begin(); i != objects.end();)
+                i = objects.erase(i);
+                continue;
+            }
+            o->setupNewState();
+            PositionF position = o->getPosition();
+            VectorF extents = o->getExtents();
+            float fMinX = position.x - extents.x;
+            float fMaxX = position.x + extents.x;
+            int minX = ifloor(fMinX * xScaleFactor);
+            int maxX = iceil(fMaxX * xScaleFactor);
+            float fMinZ = position.z - extents.z;
+            float fMaxZ = position.z + extents.z;
+            int minZ = ifloor(fMinZ * zScaleFactor);
+            int maxZ = iceil(fMaxZ * zScaleFactor);
+            if((size_t)(maxZ - minZ) * (size_t)(maxX * minX) > (size_t)(xScaleFactor + 1) * (size_t)(zScaleFactor + 1))
             {
-                shared_ptr<PhysicsObject> o = *i;
-                if(!o || o->isDestroyed())
-                {
-                    i = objects.erase(i);
-                    continue;
-                }
-                o->setupNewState();
-                PositionF position = o->getPosition();
-                VectorF extents = o->getExtents();
-                float fMinX = position.x - extents.x;
-                float fMaxX = position.x + extents.x;
-                int minX = ifloor(fMinX * xScaleFactor);
-                int maxX = iceil(fMaxX * xScaleFactor);
-                float fMinZ = position.z - extents.z;
-                float fMaxZ = position.z + extents.z;
-                int minZ = ifloor(fMinZ * zScaleFactor);
-                int maxZ = iceil(fMaxZ * zScaleFactor);
-                if((size_t)(maxZ - minZ) * (size_t)(maxX * minX) > (size_t)(xScaleFactor + 1) * (size_t)(zScaleFactor + 1))
-                {
-                    collideObjectsList.push_back(o);
-                }
-                else
+                collideObjectsList.push_back(o);
+            }
+            else
+            {
+                for(int xPosition = minX; xPosition <= maxX; xPosition++)
                 {
-                    for(int xPosition = minX; xPosition <= maxX; xPosition++)
+                    for(int zPosition = minZ; zPosition <= maxZ; zPosition++)
                     {
-                        for(int zPosition = minZ; zPosition <= maxZ; zPosition++)
-                        {
-                            HashNode * node = freeListHead;
-                            if(node != nullptr)
-                                freeListHead = freeListHead->hashNext;
-                            else
-                                node = new HashNode;
-                            size_t hash = (size_t)(xPosition * 8191 + zPosition) % bigHashPrime;
-                            node->hashNext = overallHashTable.at(hash);
-                            node->x = xPosition;
-                            node->z = zPosition;
-                            node->object = o;
-                            overallHashTable.at(hash) = node;
-                        }
+                        HashNode * node = freeListHead;
+                        if(node != nullptr)
+                            freeListHead = freeListHead->hashNext;
+                        else
+                            node = new HashNode;
+                        size_t hash = (size_t)(xPosition * 8191 + zPosition) % bigHashPrime;
+                        node->hashNext = overallHashTable.at(hash);
+                        node->x = xPosition;
+                        node->z = zPosition;
+                        node->object = o;
+                        overallHashTable.at(hash) = node;
                     }
                 }
-                i++;
             }
-            size_t startCollideObjectsListSize = collideObjectsList.size();
-            for(shared_ptr<PhysicsObject> objectA : objects)
+            i++;
+        }
+        size_t startCollideObjectsListSize = collideObjectsList.size();
+        for(shared_ptr<PhysicsObject> objectA : objects)
+        {
+            if(objectA->isStatic())
+                continue;
+            collideObjectsList.resize(startCollideObjectsListSize);
+            PositionF position = objectA->getPosition();
+            VectorF extents = objectA->getExtents();
+            float fMinX = position.x - extents.x;
+            float fMaxX = position.x + extents.x;
+            int minX = ifloor(fMinX * xScaleFactor);
+            int maxX = iceil(fMaxX * xScaleFactor);
+            float fMinZ = position.z - extents.z;
+            float fMaxZ = position.z + extents.z;
+            int minZ = ifloor(fMinZ * zScaleFactor);
+            int maxZ = iceil(fMaxZ * zScaleFactor);
+            array<HashNode *, smallHashPrime> perObjectHashTable;
+            perObjectHashTable.fill(nullptr);
+            for(int xPosition = minX; xPosition <= maxX; xPosition++)
             {
-                if(objectA->isStatic())
-                    continue;
-                collideObjectsList.resize(startCollideObjectsListSize);
-                PositionF position = objectA->getPosition();
-                VectorF extents = objectA->getExtents();
-                float fMinX = position.x - extents.x;
-                float fMaxX = position.x + extents.x;
-                int minX = ifloor(fMinX * xScaleFactor);
-                int maxX = iceil(fMaxX * xScaleFactor);
-                float fMinZ = position.z - extents.z;
-                float fMaxZ = position.z + extents.z;
-                int minZ = ifloor(fMinZ * zScaleFactor);
-                int maxZ = iceil(fMaxZ * zScaleFactor);
-                array<HashNode *, smallHashPrime> perObjectHashTable;
-                perObjectHashTable.fill(nullptr);
-                for(int xPosition = minX; xPosition <= maxX; xPosition++)
+                for(int zPosition = minZ; zPosition <= maxZ; zPosition++)
                 {
-                    for(int zPosition = minZ; zPosition <= maxZ; zPosition++)
+                    size_t hash = (size_t)(xPosition * 8191 + zPosition);
+                    hash %= bigHashPrime;
+                    HashNode * node = overallHashTable.at(hash);
+                    while(node != nullptr)
                     {
-                        size_t hash = (size_t)(xPosition * 8191 + zPosition);
-                        hash %= bigHashPrime;
-                        HashNode * node = overallHashTable.at(hash);
-                        while(node != nullptr)
+                        if(node->x == xPosition && node->z == zPosition) // found one
                         {
-                            if(node->x == xPosition && node->z == zPosition) // found one
+                            size_t perObjectHash = std::hash<shared_ptr<PhysicsObject>>()(node->object) % smallHashPrime;
+                            HashNode ** pnode = &perObjectHashTable.at(perObjectHash);
+                            HashNode * node2 = *pnode;
+                            bool found = false;
+                            while(node2 != nullptr)
                             {
-                                size_t perObjectHash = std::hash<shared_ptr<PhysicsObject>>()(node->object) % smallHashPrime;
-                                HashNode ** pnode = &perObjectHashTable.at(perObjectHash);
-                                HashNode * node2 = *pnode;
-                                bool found = false;
-                                while(node2 != nullptr)
-                                {
-                                    if(node2->object == node->object)
-                                    {
-                                        found = true;
-                                        break;
-                                    }
-                                    pnode = &node2->hashNext;
-                                    node2 = *pnode;
-                                }
-                                if(!found)
+                                if(node2->object == node->object)
                                 {
-                                    node2 = freeListHead;
-                                    if(node2 == nullptr)
-                                        node2 = new HashNode;
-                                    else
-                                        freeListHead = node2->hashNext;
-                                    node2->hashNext = perObjectHashTable.at(perObjectHash);
-                                    node2->object = node->object;
-                                    node2->x = node2->z = 0;
-                                    perObjectHashTable.at(perObjectHash) = node2;
-                                    collideObjectsList.push_back(node->object);
+                                    found = true;
+                                    break;
                                 }
+                                pnode = &node2->hashNext;
+                                node2 = *pnode;
+                            }
+                            if(!found)
+                            {
+                                node2 = freeListHead;
+                                if(node2 == nullptr)
+                                    node2 = new HashNode;
+                                else
+                                    freeListHead = node2->hashNext;
+                                node2->hashNext = perObjectHashTable.at(perObjectHash);
+                                node2->object = node->object;
+                                node2->x = node2->z = 0;
+                                perObjectHashTable.at(perObjectHash) = node2;
+                                collideObjectsList.push_back(node->object);
                             }
-                            node = node->hashNext;
                         }
-                    }
-                }
-                for(HashNode * node : perObjectHashTable)
-                {
-                    while(node != nullptr)
-                    {
-                        HashNode * nextNode = node->hashNext;
-                        node->hashNext = freeListHead;
-                        freeListHead = node;
-                        node = nextNode;
-                    }
-                }
-                for(auto objectB : collideObjectsList)
-                {
-                    if(objectA != objectB && objectA->collides(*objectB))
-                    {
-                        anyCollisions = true;
-                        objectA->adjustPosition(*objectB);
-                        //cout << "collision" << endl;
-                    }
-                }
-                if(objectA->constraints)
-                {
-                    for(PhysicsConstraint constraint : *objectA->constraints)
-                    {
-                        if(constraint)
-                            constraint(objectA->position[getNewVariableSetIndex()], objectA->velocity[getNewVariableSetIndex()]);
+                        node = node->hashNext;
                     }
                 }
             }
-            for(HashNode * node : overallHashTable)
+            for(HashNode * node : perObjectHashTable)
             {
                 while(node != nullptr)
                 {
@@ -561,8 +757,35 @@ inline void PhysicsWorld::runToTime(double stopTime)
                     node = nextNode;
                 }
             }
-            swapVariableSetIndex();
+            for(auto objectB : collideObjectsList)
+            {
+                if(objectA != objectB && objectA->collides(*objectB))
+                {
+                    anyCollisions = true;
+                    objectA->adjustPosition(*objectB);
+                    //cout << "collision" << endl;
+                }
+            }
+            if(objectA->constraints)
+            {
+                for(PhysicsConstraint constraint : *objectA->constraints)
+                {
+                    if(constraint)
+                        constraint(objectA->position[getNewVariableSetIndex()], objectA->velocity[getNewVariableSetIndex()]);
+                }
+            }
+        }
+        for(HashNode * node : overallHashTable)
+        {
+            while(node != nullptr)
+            {
+                HashNode * nextNode = node->hashNext;
+                node->hashNext = freeListHead;
+                freeListHead = node;
+                node = nextNode;
+            }
         }
+        swapVariableSetIndex();
     }
 }
 
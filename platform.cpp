@@ -28,8 +28,9 @@
 #include <chrono>
 #include <atomic>
 #include <thread>
-#include <mutex>
 #include "audio.h"
+#include "frame_profiler.h"
+#include "mesh.h"
 
 #ifndef SDL_HINT_MAC_CTRL_CLICK_EMULATE_RIGHT_CLICK
 #define SDL_HINT_MAC_CTRL_CLICK_EMULATE_RIGHT_CLICK "SDL_MAC_CTRL_CLICK_EMULATE_RIGHT_CLICK"
@@ -42,39 +43,6 @@ double Display::realtimeTimer()
     return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count()) * 1e-9;
 }
 
-namespace
-{
-class RWOpsReader final : public Reader
-{
-private:
-    SDL_RWops * rw;
-public:
-    RWOpsReader(SDL_RWops * rw)
-        : rw(rw)
-    {
-        if(rw == nullptr)
-            throw IOException("invalid RWOps");
-    }
-    virtual uint8_t readByte() override
-    {
-        SDL_ClearError(); // for error detection
-        uint8_t retval;
-        if(0 == SDL_RWread(rw, &retval, sizeof(retval), 1))
-        {
-            const char * str = SDL_GetError();
-            if(str[0]) // non-empty string : error
-                throw IOException(str);
-            throw EOFException();
-        }
-        return retval;
-    }
-    ~RWOpsReader()
-    {
-        SDL_RWclose(rw);
-    }
-};
-}
-
 static void startSDL();
 
 #ifdef _WIN64
@@ -137,8 +105,7 @@ static void calcResourcePrefix()
 shared_ptr<Reader> getResourceReader(wstring resource)
 {
     startSDL();
-    string fname = wcsrtombs(getResourceFileName(resource));
-    return make_shared<RWOpsReader>(SDL_RWFromFile(fname.c_str(), "rb"));
+    return make_shared<MmapReader>(getResourceFileName(resource));
 }
 #elif __unix
 #error implement getResourceReader for other unix
@@ -246,8 +213,15 @@ bool audioRunning()
     return validAudio;
 }
 
+bool graphicsRunning()
+{
+    return runningGraphics;
+}
+
 void endGraphics()
 {
+    if(runningGraphics)
+        MeshBufferObject::deleteFreedBuffers();
     if(runningGraphics.exchange(false))
     {
         SDL_GL_DeleteContext(glcontext);
@@ -324,61 +298,85 @@ void startGraphics()
     SDL_SetHint(SDL_HINT_MAC_CTRL_CLICK_EMULATE_RIGHT_CLICK, "1");
 }
 
-static volatile double lastFlipTime = 0;
-
-static volatile double oldLastFlipTime = 0;
+/// the frame timing state. flipDisplay is the only writer
+struct FlipTimes
+{
+    double lastFlipTime;
+    double oldLastFlipTime;
+    float averageFPS;
+};
 
-static recursive_mutex flipTimeLock;
+/** seqlock around the frame timing : the sequence is odd while flipDisplay is writing.
+ * readers never block the writer and only retry if they overlap a write.
+ */
+static atomic_uint flipTimesSequence(0);
+static atomic<double> lastFlipTime(0);
+static atomic<double> oldLastFlipTime(0);
+static atomic<float> averageFPSInternal(defaultFPS);
 
-static void lockFlipTime()
+static FlipTimes readFlipTimes()
 {
-    flipTimeLock.lock();
+    FlipTimes retval;
+    while(true)
+    {
+        unsigned sequence = flipTimesSequence.load(memory_order_acquire);
+        if(sequence % 2 == 0)
+        {
+            retval.lastFlipTime = lastFlipTime.load(memory_order_relaxed);
+            retval.oldLastFlipTime = oldLastFlipTime.load(memory_order_relaxed);
+            retval.averageFPS = averageFPSInternal.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if(flipTimesSequence.load(memory_order_relaxed) == sequence)
+                return retval;
+        }
+        else
+            this_thread::yield();
+    }
 }
 
-static void unlockFlipTime()
+static void writeFlipTimes(const FlipTimes &times)
 {
-    flipTimeLock.unlock();
+    unsigned sequence = flipTimesSequence.load(memory_order_relaxed);
+    flipTimesSequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    lastFlipTime.store(times.lastFlipTime, memory_order_relaxed);
+    oldLastFlipTime.store(times.oldLastFlipTime, memory_order_relaxed);
+    averageFPSInternal.store(times.averageFPS, memory_order_relaxed);
+    flipTimesSequence.store(sequence + 2, memory_order_release);
 }
 
-struct FlipTimeLocker
-{
-    FlipTimeLocker()
-    {
-        lockFlipTime();
-    }
-    ~FlipTimeLocker()
-    {
-        unlockFlipTime();
-    }
-};
-
 initializer initializer3([]()
 {
-    lastFlipTime = Display::realtimeTimer();
+    FlipTimes times;
+    times.lastFlipTime = Display::realtimeTimer();
     const float fps = defaultFPS;
-    oldLastFlipTime = lastFlipTime - static_cast<double>(1) / fps;
+    times.oldLastFlipTime = times.lastFlipTime - static_cast<double>(1) / fps;
+    times.averageFPS = defaultFPS;
+    writeFlipTimes(times);
 });
 
-static volatile float averageFPSInternal = defaultFPS;
-
-static double instantaneousFPS()
+static double instantaneousFPS(const FlipTimes &times)
 {
-    FlipTimeLocker lock;
-    double delta = lastFlipTime - oldLastFlipTime;
+    double delta = times.lastFlipTime - times.oldLastFlipTime;
     if(delta <= eps || delta > 0.25)
     {
-        return averageFPSInternal;
+        return times.averageFPS;
     }
     return 1 / delta;
 }
 
+static double instantaneousFPS()
+{
+    return instantaneousFPS(readFlipTimes());
+}
+
 static double frameDeltaTime()
 {
-    FlipTimeLocker lock;
-    double delta = lastFlipTime - oldLastFlipTime;
+    FlipTimes times = readFlipTimes();
+    double delta = times.lastFlipTime - times.oldLastFlipTime;
     if(delta <= eps || delta > 0.25)
     {
-        return 1 / averageFPSInternal;
+        return 1 / times.averageFPS;
     }
     return delta;
 }
@@ -387,36 +385,33 @@ const float FPSUpdateFactor = 0.1f;
 
 static float averageFPS()
 {
-    FlipTimeLocker lock;
-    return averageFPSInternal;
+    return averageFPSInternal.load(memory_order_relaxed);
+}
+
+static void recordFlip(FlipTimes &times, double flipTime)
+{
+    times.oldLastFlipTime = times.lastFlipTime;
+    times.lastFlipTime = flipTime;
+    times.averageFPS *= 1 - FPSUpdateFactor;
+    times.averageFPS += FPSUpdateFactor * instantaneousFPS(times);
+    writeFlipTimes(times);
 }
 
 static void flipDisplay(float fps = defaultFPS)
 {
-    double sleepTime;
+    FlipTimes times = readFlipTimes();
+    double curTime = Display::realtimeTimer();
+    double sleepTime = 1 / fps - (curTime - times.lastFlipTime);
+    if(sleepTime <= eps)
     {
-        FlipTimeLocker lock;
-        double curTime = Display::realtimeTimer();
-        sleepTime = 1 / fps - (curTime - lastFlipTime);
-        if(sleepTime <= eps)
-        {
-            oldLastFlipTime = lastFlipTime;
-            lastFlipTime = curTime;
-            averageFPSInternal *= 1 - FPSUpdateFactor;
-            averageFPSInternal += FPSUpdateFactor * instantaneousFPS();
-        }
+        recordFlip(times, curTime);
     }
-    if(sleepTime > eps)
+    else
     {
         this_thread::sleep_for(chrono::nanoseconds(static_cast<int64_t>(sleepTime * 1e9)));
-        {
-            FlipTimeLocker lock;
-            oldLastFlipTime = lastFlipTime;
-            lastFlipTime = Display::realtimeTimer();
-            averageFPSInternal *= 1 - FPSUpdateFactor;
-            averageFPSInternal += FPSUpdateFactor * instantaneousFPS();
-        }
+        recordFlip(times, Display::realtimeTimer());
     }
+    FrameProfiler::Scope profilerScope(FrameProfiler::Swap);
     SDL_GL_SwapWindow(window);
 }
 
@@ -853,9 +848,9 @@ static void handleEvents(shared_ptr<EventHandler> eventHandler)
     }
 }
 
-void glLoadMatrix(Matrix mat)
+static void getMatrixArray(Matrix mat, float matArray[16])
 {
-    float matArray[16] =
+    const float values[16] =
     {
         mat.x00,
         mat.x01,
@@ -877,9 +872,24 @@ void glLoadMatrix(Matrix mat)
         mat.x32,
         1,
     };
+    for(size_t i = 0; i < 16; i++)
+        matArray[i] = values[i];
+}
+
+void glLoadMatrix(Matrix mat)
+{
+    float matArray[16];
+    getMatrixArray(mat, matArray);
     glLoadMatrixf(static_cast<const float *>(matArray));
 }
 
+void glMultMatrix(Matrix mat)
+{
+    float matArray[16];
+    getMatrixArray(mat, matArray);
+    glMultMatrixf(static_cast<const float *>(matArray));
+}
+
 wstring Display::title()
 {
     return mbsrtowcs(SDL_GetWindowTitle(window));
@@ -893,6 +903,7 @@ void Display::title(wstring newTitle)
 
 void Display::handleEvents(shared_ptr<EventHandler> eventHandler)
 {
+    FrameProfiler::Scope profilerScope(FrameProfiler::Events);
     ::handleEvents(eventHandler);
 }
 
@@ -912,6 +923,7 @@ void Display::flip(float fps)
 {
     flipDisplay(fps);
     updateTimer();
+    FrameProfiler::global().endFrame();
 }
 
 double Display::instantaneousFPS()
@@ -968,6 +980,7 @@ void Display::initFrame()
         scaleXInternal = 1.0;
         scaleYInternal = static_cast<float>(height()) / width();
     }
+    MeshBufferObject::deleteFreedBuffers();
     //glDisable(GL_DEPTH_TEST);
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_TEXTURE_2D);
@@ -30,6 +30,7 @@ class EventHandler;
 #endif // EVENT_H_INCLUDED
 
 void glLoadMatrix(Matrix mat);
+void glMultMatrix(Matrix mat);
 
 const float defaultFPS = 60;
 
@@ -242,6 +243,7 @@ namespace Display
 
 void startGraphics();
 void endGraphics();
+bool graphicsRunning();
 void startAudio();
 void endAudio();
 unsigned getGlobalAudioSampleRate();
@@ -0,0 +1,138 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "render_queue.h"
+#include "platform.h"
+#include "frustum.h"
+#include "frame_profiler.h"
+#include <algorithm>
+
+constexpr size_t RenderQueue::mergeTriangleLimit;
+
+void RenderQueue::submit(TransformedMesh mesh, BlendMode blend)
+{
+    if(mesh.mesh == nullptr || mesh.mesh->size() == 0)
+        return;
+    // the camera looks down the negative z axis so this is the distance in front of the camera
+    float depth = -transform(mesh.tform, mesh.mesh->bounds().center()).z;
+    entries.push_back(Entry(mesh, blend, depth));
+}
+
+void RenderQueue::flushMergeBuffer(Renderer &renderer, RenderQueueStats &stats)
+{
+    if(mergeBuffer.size() == 0)
+        return;
+    renderer << mergeBuffer;
+    stats.drawCalls++;
+    mergeBuffer.clear();
+}
+
+void RenderQueue::flushLargeMeshes(Renderer &renderer, RenderQueueStats &stats)
+{
+    if(largeMeshes.empty())
+        return;
+    renderer << largeMeshes;
+    stats.drawCalls += largeMeshes.size();
+    largeMeshes.clear();
+}
+
+void RenderQueue::render(Renderer &renderer)
+{
+    FrameProfiler::Scope profilerScope(FrameProfiler::Submit);
+    RenderQueueStats stats;
+    stats.submissions = entries.size();
+    const Frustum frustum = Frustum::current();
+    entries.erase(remove_if(entries.begin(), entries.end(), [&frustum](const Entry & entry)
+    {
+        return !frustum.visible(entry.mesh);
+    }), entries.end());
+    stats.culled = stats.submissions - entries.size();
+    stable_sort(entries.begin(), entries.end(), [](const Entry & a, const Entry & b)
+    {
+        if(a.blend != b.blend)
+            return a.blend == BlendMode::Opaque;
+        const Image &aTexture = a.mesh.mesh->texture(), &bTexture = b.mesh.mesh->texture();
+        if(a.blend == BlendMode::Opaque)
+        {
+            if(aTexture != bTexture)
+                return aTexture < bTexture;
+            return a.depth < b.depth;
+        }
+        if(a.depth != b.depth)
+            return a.depth > b.depth;
+        return aTexture < bTexture;
+    });
+    bool haveState = false;
+    BlendMode currentBlend = BlendMode::Opaque;
+    Image currentTexture;
+    for(auto runStart = entries.begin(); runStart != entries.end();)
+    {
+        const BlendMode blend = runStart->blend;
+        const Image texture = runStart->mesh.mesh->texture();
+        auto runEnd = runStart + 1;
+        while(runEnd != entries.end() && runEnd->blend == blend && runEnd->mesh.mesh->texture() == texture)
+            runEnd++;
+        if(!haveState || blend != currentBlend)
+        {
+            if(blend == BlendMode::Opaque)
+            {
+                glDisable(GL_BLEND);
+                glDepthMask(GL_TRUE);
+            }
+            else
+            {
+                glEnable(GL_BLEND);
+                glDepthMask(GL_FALSE);
+            }
+            currentBlend = blend;
+            stats.blendChanges++;
+        }
+        if(!haveState || texture != currentTexture)
+        {
+            currentTexture = texture;
+            stats.textureChanges++;
+        }
+        haveState = true;
+        for(auto i = runStart; i != runEnd; i++)
+        {
+            stats.triangles += i->mesh.mesh->size();
+            if(i->mesh.mesh->size() <= mergeTriangleLimit)
+            {
+                mergeBuffer.add(i->mesh);
+                continue;
+            }
+            if(blend == BlendMode::Translucent) // keep the back to front order
+            {
+                flushMergeBuffer(renderer, stats);
+                largeMeshes.push_back(i->mesh);
+                flushLargeMeshes(renderer, stats);
+            }
+            else
+                largeMeshes.push_back(i->mesh);
+        }
+        flushMergeBuffer(renderer, stats);
+        flushLargeMeshes(renderer, stats);
+        runStart = runEnd;
+    }
+    if(haveState) // back to the state from Display::initFrame
+    {
+        glEnable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
+    entries.clear();
+    lastFrameStats = stats;
+}
@@ -0,0 +1,101 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef RENDER_QUEUE_H_INCLUDED
+#define RENDER_QUEUE_H_INCLUDED
+
+#include "mesh.h"
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+enum class BlendMode
+{
+    Opaque,
+    Translucent
+};
+
+/// what a RenderQueue did to draw a frame
+struct RenderQueueStats
+{
+    size_t submissions = 0;
+    size_t culled = 0;
+    size_t drawCalls = 0;
+    size_t textureChanges = 0;
+    size_t blendChanges = 0;
+    size_t triangles = 0;
+};
+
+/** collects meshes with any mix of textures and draws them together.
+ * submissions are sorted by blend mode, texture and depth : opaque meshes are drawn first, grouped by texture and front to back,
+ * then translucent meshes are drawn back to front with depth writes turned off.
+ * small meshes with the same texture and blend mode are merged into one draw.
+ * meshes outside of the view frustum are dropped before anything is transformed.
+ */
+class RenderQueue final
+{
+private:
+    struct Entry
+    {
+        TransformedMesh mesh;
+        BlendMode blend;
+        float depth;
+        Entry(TransformedMesh mesh, BlendMode blend, float depth)
+            : mesh(mesh), blend(blend), depth(depth)
+        {
+        }
+    };
+    vector<Entry> entries;
+    Mesh_t mergeBuffer;
+    vector<TransformedMesh> largeMeshes;
+    RenderQueueStats lastFrameStats;
+    RenderQueue(const RenderQueue &) = delete;
+    const RenderQueue &operator =(const RenderQueue &) = delete;
+    void flushMergeBuffer(Renderer &renderer, RenderQueueStats &stats);
+    void flushLargeMeshes(Renderer &renderer, RenderQueueStats &stats);
+public:
+    /// meshes with at most this many triangles are transformed on the CPU and merged with other submissions instead of being drawn by themselves
+    static constexpr size_t mergeTriangleLimit = 256;
+    RenderQueue()
+    {
+    }
+    /** add a mesh to be drawn by the next call to render
+     *
+     * @param mesh the mesh to draw, transformed into eye coordinates
+     * @param blend if the mesh needs to be blended with what's behind it
+     */
+    void submit(TransformedMesh mesh, BlendMode blend = BlendMode::Opaque);
+    void submit(Mesh mesh, BlendMode blend = BlendMode::Opaque)
+    {
+        submit(TransformedMesh(mesh, Matrix::identity()), blend);
+    }
+    /// draw and remove all the submitted meshes
+    void render(Renderer &renderer);
+    /// remove all the submitted meshes without drawing them
+    void clear()
+    {
+        entries.clear();
+    }
+    /// @return the counts from the last call to render
+    const RenderQueueStats &stats() const
+    {
+        return lastFrameStats;
+    }
+};
+
+#endif // RENDER_QUEUE_H_INCLUDED
@@ -0,0 +1,198 @@
+/*
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef SCENE_H_INCLUDED
+#define SCENE_H_INCLUDED
+
+#include "mesh.h"
+#include "frame_profiler.h"
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+class Scene;
+
+/// a mesh placed in a Scene
+class SceneNode final
+{
+    friend class Scene;
+private:
+    Mesh mesh;
+    Matrix tform;
+    Color factor;
+    bool visible = true;
+    bool isStatic_;
+    bool dirty = true;
+    SceneNode(Mesh mesh, Matrix tform, Color factor, bool isStatic)
+        : mesh(mesh), tform(tform), factor(factor), isStatic_(isStatic)
+    {
+    }
+    SceneNode(const SceneNode &) = delete;
+    const SceneNode &operator =(const SceneNode &) = delete;
+public:
+    Mesh getMesh() const
+    {
+        return mesh;
+    }
+    void setMesh(Mesh newMesh)
+    {
+        if(newMesh != mesh)
+        {
+            mesh = newMesh;
+            dirty = true;
+        }
+    }
+    const Matrix &getTransform() const
+    {
+        return tform;
+    }
+    void setTransform(const Matrix &newTransform)
+    {
+        if(newTransform != tform)
+        {
+            tform = newTransform;
+            dirty = true;
+        }
+    }
+    Color getColorFactor() const
+    {
+        return factor;
+    }
+    void setColorFactor(Color newFactor)
+    {
+        if(newFactor.r != factor.r || newFactor.g != factor.g || newFactor.b != factor.b || newFactor.a != factor.a)
+        {
+            factor = newFactor;
+            dirty = true;
+        }
+    }
+    bool isVisible() const
+    {
+        return visible;
+    }
+    void setVisible(bool newVisible)
+    {
+        if(newVisible != visible)
+        {
+            visible = newVisible;
+            dirty = true;
+        }
+    }
+    bool isStatic() const
+    {
+        return isStatic_;
+    }
+};
+
+/** retained scene : static nodes are baked into one mesh per texture that is only rebuilt when one of them changes,
+ * so it stays in its buffer object between frames. Dynamic nodes are drawn as instances of their meshes
+ * so changing their transforms doesn't touch any vertices.
+ */
+class Scene final
+{
+private:
+    vector<shared_ptr<SceneNode>> staticNodes, dynamicNodes;
+    vector<Mesh> staticMeshes;
+    bool staticMeshValid = false;
+    vector<TransformedMesh> batch;
+    Scene(const Scene &) = delete;
+    const Scene &operator =(const Scene &) = delete;
+    void updateStaticMesh()
+    {
+        FrameProfiler::Scope profilerScope(FrameProfiler::MeshBuild);
+        bool anyDirty = !staticMeshValid;
+        for(shared_ptr<SceneNode> node : staticNodes)
+        {
+            if(node->dirty)
+                anyDirty = true;
+            node->dirty = false;
+        }
+        if(!anyDirty)
+            return;
+        // a mesh can only have one texture, so group the nodes by texture
+        vector<Image> textures;
+        vector<vector<const SceneNode *>> groups;
+        for(shared_ptr<SceneNode> node : staticNodes)
+        {
+            if(!node->visible || node->mesh == nullptr || node->mesh->size() == 0)
+                continue;
+            Image texture = node->mesh->texture();
+            size_t group = find(textures.begin(), textures.end(), texture) - textures.begin();
+            if(group == textures.size())
+            {
+                textures.push_back(texture);
+                groups.push_back(vector<const SceneNode *>());
+            }
+            groups[group].push_back(node.get());
+        }
+        staticMeshes.clear();
+        for(const vector<const SceneNode *> &nodes : groups)
+        {
+            staticMeshes.push_back(buildMesh(nodes.size(), [&nodes](size_t index, Mesh_t & dest)
+            {
+                const SceneNode &node = *nodes[index];
+                dest.add(TransformedMesh(node.mesh, node.tform, node.factor));
+            }));
+        }
+        staticMeshValid = true;
+    }
+public:
+    Scene()
+    {
+    }
+    shared_ptr<SceneNode> add(Mesh mesh, Matrix tform = Matrix::identity(), bool isStatic = false, Color factor = Color(1, 1, 1, 1))
+    {
+        shared_ptr<SceneNode> retval = shared_ptr<SceneNode>(new SceneNode(mesh, tform, factor, isStatic));
+        if(isStatic)
+        {
+            staticNodes.push_back(retval);
+            staticMeshValid = false;
+        }
+        else
+            dynamicNodes.push_back(retval);
+        return retval;
+    }
+    void remove(shared_ptr<SceneNode> node)
+    {
+        vector<shared_ptr<SceneNode>> &nodes = (node->isStatic() ? staticNodes : dynamicNodes);
+        auto iter = find(nodes.begin(), nodes.end(), node);
+        if(iter == nodes.end())
+            return;
+        nodes.erase(iter);
+        if(node->isStatic())
+            staticMeshValid = false;
+    }
+    void render(Renderer &renderer, const Matrix &viewMatrix = Matrix::identity())
+    {
+        updateStaticMesh();
+        batch.clear();
+        for(Mesh staticMesh : staticMeshes)
+            batch.push_back(TransformedMesh(staticMesh, viewMatrix));
+        for(shared_ptr<SceneNode> node : dynamicNodes)
+        {
+            node->dirty = false;
+            if(node->visible && node->mesh != nullptr)
+                batch.push_back(TransformedMesh(node->mesh, node->tform.concat(viewMatrix), node->factor));
+        }
+        FrameProfiler::Scope profilerScope(FrameProfiler::Submit);
+        renderer << batch;
+    }
+};
+
+#endif // SCENE_H_INCLUDED
@@ -17,11 +17,15 @@
  */
 #include "stream.h"
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <cerrno>
 #include <iostream>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <atomic>
 #include "util.h"
 
 using namespace std;
@@ -29,15 +33,109 @@ using namespace std;
 namespace
 {
 const size_t bufferSize = 32768;
+static_assert((bufferSize & (bufferSize - 1)) == 0, "bufferSize must be a power of 2");
 
+/** single-producer single-consumer ring buffer.
+ * the indices only ever increase and are masked when used, so readIndex == writeIndex means empty and
+ * writeIndex - readIndex == bufferSize means full. each side only takes waitLock to sleep when the ring
+ * is empty or full, or to wake the other side if it is asleep.
+ */
 struct Pipe
 {
-    mutex lock;
-    condition_variable_any cond;
-    bool closed = false;
-    queue<uint8_t, circularDeque<uint8_t, bufferSize + 1>> buffer;
+    atomic_size_t readIndex;
+    char readIndexPadding[64];
+    atomic_size_t writeIndex;
+    char writeIndexPadding[64];
+    atomic_bool closed, readerWaiting, writerWaiting;
+    mutex waitLock;
+    condition_variable waitCond;
+    uint8_t buffer[bufferSize];
+    Pipe()
+        : readIndex(0), writeIndex(0), closed(false), readerWaiting(false), writerWaiting(false)
+    {
+    }
+    void close()
+    {
+        closed.store(true);
+        lock_guard<mutex> lockIt(waitLock);
+        waitCond.notify_all();
+    }
+    void wake(atomic_bool &waiting)
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+        if(waiting.load(memory_order_relaxed))
+        {
+            lock_guard<mutex> lockIt(waitLock);
+            waitCond.notify_all();
+        }
+    }
+    /// @return the number of bytes that can be read, waiting if the ring is empty. 0 means the writer is closed
+    size_t waitForData(size_t readPosition)
+    {
+        size_t available = writeIndex.load(memory_order_acquire) - readPosition;
+        if(available > 0)
+            return available;
+        unique_lock<mutex> lockIt(waitLock);
+        readerWaiting.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        while((available = writeIndex.load(memory_order_acquire) - readPosition) == 0 && !closed.load())
+        {
+            waitCond.wait(lockIt);
+        }
+        readerWaiting.store(false, memory_order_relaxed);
+        if(available == 0) // the writer might have written right before closing
+            available = writeIndex.load(memory_order_acquire) - readPosition;
+        return available;
+    }
+    /// @return the number of bytes that can be written, waiting if the ring is full. 0 means the reader is closed
+    size_t waitForSpace(size_t writePosition)
+    {
+        if(closed.load(memory_order_relaxed))
+            return 0;
+        size_t space = bufferSize - (writePosition - readIndex.load(memory_order_acquire));
+        if(space > 0)
+            return space;
+        unique_lock<mutex> lockIt(waitLock);
+        writerWaiting.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        while((space = bufferSize - (writePosition - readIndex.load(memory_order_acquire))) == 0 && !closed.load())
+        {
+            waitCond.wait(lockIt);
+        }
+        writerWaiting.store(false, memory_order_relaxed);
+        if(closed.load())
+            return 0;
+        return space;
+    }
+    /// copy up to count bytes out of the ring without waiting
+    size_t read(uint8_t * array, size_t count, size_t available)
+    {
+        size_t readPosition = readIndex.load(memory_order_relaxed);
+        count = min(count, available);
+        size_t start = readPosition & (bufferSize - 1);
+        size_t firstPart = min(count, bufferSize - start);
+        memcpy((void *)array, (const void *)&buffer[start], firstPart);
+        memcpy((void *)(array + firstPart), (const void *)&buffer[0], count - firstPart);
+        readIndex.store(readPosition + count, memory_order_release);
+        wake(writerWaiting);
+        return count;
+    }
+    /// copy up to count bytes into the ring without waiting
+    size_t write(const uint8_t * array, size_t count, size_t space)
+    {
+        size_t writePosition = writeIndex.load(memory_order_relaxed);
+        count = min(count, space);
+        size_t start = writePosition & (bufferSize - 1);
+        size_t firstPart = min(count, bufferSize - start);
+        memcpy((void *)&buffer[start], (const void *)array, firstPart);
+        memcpy((void *)&buffer[0], (const void *)(array + firstPart), count - firstPart);
+        writeIndex.store(writePosition + count, memory_order_release);
+        wake(readerWaiting);
+        return count;
+    }
 };
 
+/// must only be used by one thread at a time
 class PipeReader final : public Reader
 {
 private:
@@ -49,36 +147,38 @@ public:
     }
     virtual ~PipeReader()
     {
-        pipe->lock.lock();
-        pipe->closed = true;
-        pipe->cond.notify_all();
-        pipe->lock.unlock();
+        pipe->close();
     }
     virtual uint8_t readByte() override
     {
-        pipe->lock.lock();
-        if(pipe->buffer.empty())
-        {
-            pipe->cond.notify_all();
-        }
-        while(true)
+        uint8_t retval;
+        readBytes(&retval, 1);
+        return retval;
+    }
+    virtual void readBytes(uint8_t * array, size_t count) override
+    {
+        while(count > 0)
         {
-            if(!pipe->buffer.empty())
-                break;
-            if(pipe->closed)
-            {
-                pipe->lock.unlock();
+            size_t available = pipe->waitForData(pipe->readIndex.load(memory_order_relaxed));
+            if(available == 0)
                 throw EOFException();
-            }
-            pipe->cond.wait(pipe->lock);
+            size_t readCount = pipe->read(array, count, available);
+            array += readCount;
+            count -= readCount;
         }
-        uint8_t retval = pipe->buffer.front();
-        pipe->buffer.pop();
-        pipe->lock.unlock();
-        return retval;
+    }
+    virtual size_t readUpTo(uint8_t * array, size_t count) override
+    {
+        if(count == 0)
+            return 0;
+        size_t available = pipe->waitForData(pipe->readIndex.load(memory_order_relaxed));
+        if(available == 0)
+            throw EOFException();
+        return pipe->read(array, count, available);
     }
 };
 
+/// must only be used by one thread at a time
 class PipeWriter final : public Writer
 {
 private:
@@ -91,38 +191,66 @@ public:
 
     virtual ~PipeWriter()
     {
-        pipe->lock.lock();
-        pipe->closed = true;
-        pipe->cond.notify_all();
-        pipe->lock.unlock();
+        pipe->close();
     }
 
     virtual void writeByte(uint8_t v) override
     {
-        pipe->lock.lock();
-        while(true)
+        writeBytes(&v, 1);
+    }
+
+    virtual void writeBytes(const uint8_t * array, size_t count) override
+    {
+        while(count > 0)
         {
-            if(pipe->closed)
-            {
-                pipe->lock.unlock();
+            size_t space = pipe->waitForSpace(pipe->writeIndex.load(memory_order_relaxed));
+            if(space == 0)
                 throw IOException("IO Error : can't write to pipe");
-            }
-            if(pipe->buffer.size() < bufferSize)
-                break;
-            pipe->cond.notify_all();
-            pipe->cond.wait(pipe->lock);
+            size_t writeCount = pipe->write(array, count, space);
+            array += writeCount;
+            count -= writeCount;
         }
-        pipe->buffer.push(v);
-        pipe->lock.unlock();
     }
+};
+}
 
-    virtual void flush() override
+pair<shared_ptr<const uint8_t>, size_t> MmapReader::mapFile(wstring fileName)
+{
+    string str = wcsrtombs(fileName);
+    int fd = open(str.c_str(), O_RDONLY);
+    if(fd == -1)
+        throw IOException(string("IO Error : ") + strerror(errno));
+    struct stat st;
+    if(fstat(fd, &st) == -1)
     {
-        pipe->lock.lock();
-        pipe->cond.notify_all();
-        pipe->lock.unlock();
+        int error = errno;
+        close(fd);
+        throw IOException(string("IO Error : ") + strerror(error));
     }
-};
+    if(!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        throw IOException("IO Error : can't map a file that isn't a regular file");
+    }
+    size_t length = st.st_size;
+    shared_ptr<const uint8_t> mem;
+    if(length > 0) // mmap fails for empty files
+    {
+        void * ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(ptr == MAP_FAILED)
+        {
+            int error = errno;
+            close(fd);
+            throw IOException(string("IO Error : ") + strerror(error));
+        }
+        posix_madvise(ptr, length, POSIX_MADV_SEQUENTIAL);
+        mem = shared_ptr<const uint8_t>((const uint8_t *)ptr, [length](const uint8_t * ptr)
+        {
+            munmap((void *)ptr, length);
+        });
+    }
+    close(fd);
+    return make_pair(mem, length);
 }
 
 StreamPipe::StreamPipe()
@@ -26,6 +26,10 @@
 #include <cstring>
 #include <memory>
 #include <list>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <sys/stat.h>
 #include "util.h"
 #include "dimension.h"
 #ifdef DEBUG_STREAM
@@ -104,6 +108,32 @@ private:
         }
         return v;
     }
+    /// read a big-endian unsigned integer straight from the read window or with one readBytes call
+    template <typename T>
+    T readBigEndian()
+    {
+        uint8_t buffer[sizeof(T)];
+        const uint8_t * bytes = buffer;
+        if(static_cast<size_t>(readWindowEnd - readWindow) >= sizeof(T))
+        {
+            bytes = readWindow;
+            readWindow += sizeof(T);
+        }
+        else
+            readBytes(buffer, sizeof(T));
+        T retval = 0;
+        for(size_t i = 0; i < sizeof(T); i++)
+        {
+            retval = (T)(retval << 8) | bytes[i];
+        }
+        return retval;
+    }
+protected:
+    /** the unread part of a subclass's buffer : these bytes are read without a virtual call.
+     * subclasses that set them must use them first in readByte, readBytes and readUpTo
+     */
+    const uint8_t * readWindow = nullptr;
+    const uint8_t * readWindowEnd = nullptr;
 public:
     Reader()
     {
@@ -114,29 +144,43 @@ public:
     {
     }
     virtual uint8_t readByte() = 0;
-    void readBytes(uint8_t * array, size_t count)
+    /** read exactly count bytes. readers should override this to read a whole block at once
+     * @throws EOFException if the stream ends before count bytes are read
+     */
+    virtual void readBytes(uint8_t * array, size_t count)
     {
         for(size_t i = 0; i < count; i++)
         {
             array[i] = readByte();
         }
     }
+    /** read at least 1 and at most count bytes, only waiting for the first one.
+     * used to fill buffers. the default reads one byte
+     * @return the number of bytes read
+     * @throws EOFException if the stream is at the end
+     */
+    virtual size_t readUpTo(uint8_t * array, size_t count)
+    {
+        if(count == 0)
+            return 0;
+        array[0] = readByte();
+        return 1;
+    }
     uint8_t readU8()
     {
-        uint8_t retval = readByte();
+        uint8_t retval = (readWindow != readWindowEnd ? *readWindow++ : readByte());
         DUMP_V(readU8, (unsigned)retval);
         return retval;
     }
     int8_t readS8()
     {
-        int8_t retval = readByte();
+        int8_t retval = readU8();
         DUMP_V(readS8, (int)retval);
         return retval;
     }
     uint16_t readU16()
     {
-        uint16_t v = readU8();
-        uint16_t retval = (v << 8) | readU8();
+        uint16_t retval = readBigEndian<uint16_t>();
         DUMP_V(readU16, retval);
         return retval;
     }
@@ -148,8 +192,7 @@ public:
     }
     uint32_t readU32()
     {
-        uint32_t v = readU16();
-        uint32_t retval = (v << 16) | readU16();
+        uint32_t retval = readBigEndian<uint32_t>();
         DUMP_V(readU32, retval);
         return retval;
     }
@@ -161,8 +204,7 @@ public:
     }
     uint64_t readU64()
     {
-        uint64_t v = readU32();
-        uint64_t retval = (v << 32) | readU32();
+        uint64_t retval = readBigEndian<uint64_t>();
         DUMP_V(readU64, retval);
         return retval;
     }
@@ -328,6 +370,30 @@ public:
 
 class Writer
 {
+private:
+    /// write a big-endian unsigned integer straight into the write window or with one writeBytes call
+    template <typename T>
+    void writeBigEndian(T v)
+    {
+        uint8_t buffer[sizeof(T)];
+        const bool inWindow = static_cast<size_t>(writeWindowEnd - writeWindow) >= sizeof(T);
+        uint8_t * bytes = (inWindow ? writeWindow : buffer);
+        for(size_t i = sizeof(T); i > 0; i--)
+        {
+            bytes[i - 1] = (uint8_t)(v & 0xFF);
+            v >>= 8;
+        }
+        if(inWindow)
+            writeWindow += sizeof(T);
+        else
+            writeBytes(buffer, sizeof(T));
+    }
+protected:
+    /** the free part of a subclass's buffer : these bytes are written without a virtual call.
+     * subclasses that set them must write out what was put there before anything else
+     */
+    uint8_t * writeWindow = nullptr;
+    uint8_t * writeWindowEnd = nullptr;
 public:
     Writer()
     {
@@ -341,23 +407,26 @@ public:
     virtual void flush()
     {
     }
-    void writeBytes(const uint8_t * array, size_t count)
+    /// write count bytes. writers should override this to write a whole block at once
+    virtual void writeBytes(const uint8_t * array, size_t count)
     {
         for(size_t i = 0; i < count; i++)
             writeByte(array[i]);
     }
     void writeU8(uint8_t v)
     {
-        writeByte(v);
+        if(writeWindow != writeWindowEnd)
+            *writeWindow++ = v;
+        else
+            writeByte(v);
     }
     void writeS8(int8_t v)
     {
-        writeByte(v);
+        writeU8(v);
     }
     void writeU16(uint16_t v)
     {
-        writeU8((uint8_t)(v >> 8));
-        writeU8((uint8_t)(v & 0xFF));
+        writeBigEndian(v);
     }
     void writeS16(int16_t v)
     {
@@ -365,8 +434,7 @@ public:
     }
     void writeU32(uint32_t v)
     {
-        writeU16((uint16_t)(v >> 16));
-        writeU16((uint16_t)(v & 0xFFFF));
+        writeBigEndian(v);
     }
     void writeS32(int32_t v)
     {
@@ -374,8 +442,7 @@ public:
     }
     void writeU64(uint64_t v)
     {
-        writeU32((uint64_t)(v >> 32));
-        writeU32((uint64_t)(v & 0xFFFFFFFFU));
+        writeBigEndian(v);
     }
     void writeS64(int64_t v)
     {
@@ -409,33 +476,36 @@ public:
     }
     void writeString(wstring v)
     {
+        string encoded;
+        encoded.reserve(v.length() + 1);
         for(size_t i = 0; i < v.length(); i++)
         {
             uint32_t ch = v[i];
             if(ch != 0 && ch < 0x80)
             {
-                writeU8(ch);
+                encoded += (char)ch;
             }
             else if(ch < 0x800)
             {
-                writeU8(0xC0 | ((ch >> 6) & 0x1F));
-                writeU8(0x80 | ((ch) & 0x3F));
+                encoded += (char)(0xC0 | ((ch >> 6) & 0x1F));
+                encoded += (char)(0x80 | ((ch) & 0x3F));
             }
             else if(ch < 0x1000)
             {
-                writeU8(0xE0 | ((ch >> 12) & 0xF));
-                writeU8(0x80 | ((ch >> 6) & 0x3F));
-                writeU8(0x80 | ((ch) & 0x3F));
+                encoded += (char)(0xE0 | ((ch >> 12) & 0xF));
+                encoded += (char)(0x80 | ((ch >> 6) & 0x3F));
+                encoded += (char)(0x80 | ((ch) & 0x3F));
             }
             else
             {
-                writeU8(0xF0 | ((ch >> 18) & 0x7));
-                writeU8(0x80 | ((ch >> 12) & 0x3F));
-                writeU8(0x80 | ((ch >> 6) & 0x3F));
-                writeU8(0x80 | ((ch) & 0x3F));
+                encoded += (char)(0xF0 | ((ch >> 18) & 0x7));
+                encoded += (char)(0x80 | ((ch >> 12) & 0x3F));
+                encoded += (char)(0x80 | ((ch >> 6) & 0x3F));
+                encoded += (char)(0x80 | ((ch) & 0x3F));
             }
         }
-        writeU8(0);
+        encoded += '\0';
+        writeBytes((const uint8_t *)encoded.data(), encoded.size());
     }
     void writeDimension(Dimension v)
     {
@@ -447,6 +517,12 @@ class FileReader final : public Reader
 {
 private:
     FILE * f;
+    bool isRegularFile = false;
+    void checkFileType()
+    {
+        struct stat st;
+        isRegularFile = (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode));
+    }
 public:
     FileReader(wstring fileName)
     {
@@ -454,11 +530,13 @@ public:
         f = fopen(str.c_str(), "rb");
         if(f == nullptr)
             throw IOException(string("IO Error : ") + strerror(errno));
+        checkFileType();
     }
     explicit FileReader(FILE * f)
         : f(f)
     {
         assert(f != nullptr);
+        checkFileType();
     }
     virtual ~FileReader()
     {
@@ -475,6 +553,28 @@ public:
         }
         return ch;
     }
+    virtual void readBytes(uint8_t * array, size_t count) override
+    {
+        if(fread((void *)array, 1, count, f) < count)
+        {
+            if(ferror(f))
+                throw IOException("IO Error : can't read from file");
+            throw EOFException();
+        }
+    }
+    virtual size_t readUpTo(uint8_t * array, size_t count) override
+    {
+        if(!isRegularFile) // sockets and pipes : fread would wait for the whole block
+            return Reader::readUpTo(array, count);
+        size_t retval = fread((void *)array, 1, count, f);
+        if(retval == 0 && count > 0)
+        {
+            if(ferror(f))
+                throw IOException("IO Error : can't read from file");
+            throw EOFException();
+        }
+        return retval;
+    }
 };
 
 class FileWriter final : public Writer
@@ -503,6 +603,11 @@ public:
         if(fputc(v, f) == EOF)
             throw IOException("IO Error : can't write to file");
     }
+    virtual void writeBytes(const uint8_t * array, size_t count) override
+    {
+        if(fwrite((const void *)array, 1, count, f) < count)
+            throw IOException("IO Error : can't write to file");
+    }
     virtual void flush() override
     {
         if(EOF == fflush(f))
@@ -510,27 +615,310 @@ public:
     }
 };
 
-class MemoryReader final : public Reader
+/** collects small writes like writeU8 and writeU32 in a buffer with inline copies
+ * and passes them on to another writer a block at a time
+ */
+class BufferedWriter final : public Writer
 {
 private:
-    const shared_ptr<const uint8_t> mem;
-    size_t offset;
-    const size_t length;
+    shared_ptr<Writer> writer;
+    vector<uint8_t> buffer;
+    void writeBuffer()
+    {
+        size_t count = writeWindow - buffer.data();
+        writeWindow = buffer.data();
+        writeWindowEnd = buffer.data() + buffer.size();
+        if(count > 0)
+            writer->writeBytes(buffer.data(), count);
+    }
+public:
+    static constexpr size_t defaultBufferSize = 32768;
+    explicit BufferedWriter(shared_ptr<Writer> writer, size_t bufferSize = defaultBufferSize)
+        : writer(writer), buffer(max<size_t>(bufferSize, 16))
+    {
+        writeWindow = buffer.data();
+        writeWindowEnd = buffer.data() + buffer.size();
+    }
+    explicit BufferedWriter(Writer &writer, size_t bufferSize = defaultBufferSize)
+        : BufferedWriter(shared_ptr<Writer>(&writer, [](Writer *) {}), bufferSize)
+    {
+    }
+    virtual ~BufferedWriter()
+    {
+        try
+        {
+            writeBuffer();
+        }
+        catch(IOException &)
+        {
+        }
+    }
+    virtual void writeByte(uint8_t v) override
+    {
+        if(writeWindow == writeWindowEnd)
+            writeBuffer();
+        *writeWindow++ = v;
+    }
+    virtual void writeBytes(const uint8_t * array, size_t count) override
+    {
+        if(count > static_cast<size_t>(writeWindowEnd - writeWindow))
+        {
+            writeBuffer();
+            if(count >= buffer.size())
+            {
+                writer->writeBytes(array, count);
+                return;
+            }
+        }
+        memcpy((void *)writeWindow, (const void *)array, count);
+        writeWindow += count;
+    }
+    virtual void flush() override
+    {
+        writeBuffer();
+        writer->flush();
+    }
+};
+
+/** reads bytes that are already in memory. the bytes are the read window so reads are inline copies,
+ * and data() gives them directly to code that wants them all at once
+ */
+class MemoryReader : public Reader
+{
+private:
+    shared_ptr<const uint8_t> mem;
+    size_t length;
 public:
     explicit MemoryReader(shared_ptr<const uint8_t> mem, size_t length)
-        : mem(mem), offset(0), length(length)
+        : mem(mem), length(length)
     {
+        readWindow = mem.get();
+        readWindowEnd = readWindow + length;
     }
-    template <size_t length>
-    explicit MemoryReader(const uint8_t a[length])
-        : MemoryReader(shared_ptr<const uint8_t>(&a[0], [](const uint8_t *){}))
+    /// read from an array that lives at least as long as the reader
+    template <size_t arrayLength>
+    explicit MemoryReader(const uint8_t (&a)[arrayLength])
+        : MemoryReader(shared_ptr<const uint8_t>(&a[0], [](const uint8_t *) {}), arrayLength)
     {
     }
     virtual uint8_t readByte() override
     {
-        if(offset >= length)
+        if(readWindow == readWindowEnd)
             throw EOFException();
-        return mem.get()[offset++];
+        return *readWindow++;
+    }
+    virtual void readBytes(uint8_t * array, size_t count) override
+    {
+        if(count > remaining())
+        {
+            readWindow = readWindowEnd;
+            throw EOFException();
+        }
+        memcpy((void *)array, (const void *)readWindow, count);
+        readWindow += count;
+    }
+    virtual size_t readUpTo(uint8_t * array, size_t count) override
+    {
+        if(count > 0 && readWindow == readWindowEnd)
+            throw EOFException();
+        count = min(count, remaining());
+        memcpy((void *)array, (const void *)readWindow, count);
+        readWindow += count;
+        return count;
+    }
+    /// @return all the bytes. may be nullptr if there are none
+    const uint8_t * data() const
+    {
+        return mem.get();
+    }
+    size_t size() const
+    {
+        return length;
+    }
+    /// @return the bytes that haven't been read yet
+    const uint8_t * current() const
+    {
+        return readWindow;
+    }
+    size_t remaining() const
+    {
+        return readWindowEnd - readWindow;
+    }
+    size_t tell() const
+    {
+        return length - remaining();
+    }
+    void seek(size_t position)
+    {
+        if(position > length)
+            throw IOException("IO Error : seek past end of memory");
+        readWindow = mem.get() + position;
+    }
+    /// @return a reader for sliceLength bytes starting at start that shares the memory without copying it
+    shared_ptr<MemoryReader> slice(size_t start, size_t sliceLength) const
+    {
+        if(start > length || sliceLength > length - start)
+            throw IOException("IO Error : slice past end of memory");
+        return make_shared<MemoryReader>(shared_ptr<const uint8_t>(mem, mem.get() + start), sliceLength);
+    }
+};
+
+/** writes into a growable buffer in memory. reader() shares what was written so far;
+ * the buffer is only copied if it has to grow while a reader still uses it
+ */
+class MemoryWriter final : public Writer
+{
+private:
+    shared_ptr<vector<uint8_t>> buffer;
+    void setWindow(size_t used)
+    {
+        writeWindow = buffer->data() + used;
+        writeWindowEnd = buffer->data() + buffer->size();
+    }
+    void grow(size_t extra)
+    {
+        size_t used = size();
+        size_t newCapacity = max<size_t>(max<size_t>(buffer->size() * 2, used + extra), 64);
+        if(buffer.use_count() > 1) // a reader still points at the old bytes
+        {
+            shared_ptr<vector<uint8_t>> newBuffer = make_shared<vector<uint8_t>>(newCapacity);
+            memcpy((void *)newBuffer->data(), (const void *)buffer->data(), used);
+            buffer = newBuffer;
+        }
+        else
+            buffer->resize(newCapacity);
+        setWindow(used);
+    }
+public:
+    explicit MemoryWriter(size_t initialCapacity = 0)
+        : buffer(make_shared<vector<uint8_t>>(initialCapacity))
+    {
+        setWindow(0);
+    }
+    virtual void writeByte(uint8_t v) override
+    {
+        if(writeWindow == writeWindowEnd)
+            grow(1);
+        *writeWindow++ = v;
+    }
+    virtual void writeBytes(const uint8_t * array, size_t count) override
+    {
+        if(count > static_cast<size_t>(writeWindowEnd - writeWindow))
+            grow(count);
+        memcpy((void *)writeWindow, (const void *)array, count);
+        writeWindow += count;
+    }
+    /// make room for capacity bytes in total so writes up to there don't reallocate
+    void reserve(size_t capacity)
+    {
+        if(capacity > buffer->size())
+            grow(capacity - size());
+    }
+    /// @return the number of bytes written
+    size_t size() const
+    {
+        return writeWindow - buffer->data();
+    }
+    const uint8_t * data() const
+    {
+        return buffer->data();
+    }
+    /// @return a reader for the bytes written so far. later writes don't change what it reads
+    shared_ptr<MemoryReader> reader() const
+    {
+        return make_shared<MemoryReader>(shared_ptr<const uint8_t>(buffer, buffer->data()), size());
+    }
+    /// forget the written bytes without disturbing readers that share them
+    void clear()
+    {
+        if(buffer.use_count() > 1)
+            buffer = make_shared<vector<uint8_t>>(buffer->size());
+        setWindow(0);
+    }
+};
+
+/** reads another reader a block at a time so small reads like readU8 and readU32 are inline copies
+ * out of the buffer instead of virtual calls
+ */
+class BufferedReader final : public Reader
+{
+private:
+    shared_ptr<Reader> reader;
+    vector<uint8_t> buffer;
+    void fill()
+    {
+        size_t count = reader->readUpTo(buffer.data(), buffer.size());
+        readWindow = buffer.data();
+        readWindowEnd = readWindow + count;
+    }
+    size_t copyFromWindow(uint8_t * array, size_t count)
+    {
+        count = min(count, static_cast<size_t>(readWindowEnd - readWindow));
+        memcpy((void *)array, (const void *)readWindow, count);
+        readWindow += count;
+        return count;
+    }
+public:
+    static constexpr size_t defaultBufferSize = 32768;
+    explicit BufferedReader(shared_ptr<Reader> reader, size_t bufferSize = defaultBufferSize)
+        : reader(reader), buffer(max<size_t>(bufferSize, 16))
+    {
+    }
+    explicit BufferedReader(Reader &reader, size_t bufferSize = defaultBufferSize)
+        : BufferedReader(shared_ptr<Reader>(&reader, [](Reader *) {}), bufferSize)
+    {
+    }
+    virtual uint8_t readByte() override
+    {
+        if(readWindow == readWindowEnd)
+            fill();
+        return *readWindow++;
+    }
+    virtual void readBytes(uint8_t * array, size_t count) override
+    {
+        size_t copied = copyFromWindow(array, count);
+        array += copied;
+        count -= copied;
+        if(count >= buffer.size())
+        {
+            reader->readBytes(array, count);
+            return;
+        }
+        while(count > 0)
+        {
+            fill();
+            copied = copyFromWindow(array, count);
+            array += copied;
+            count -= copied;
+        }
+    }
+    virtual size_t readUpTo(uint8_t * array, size_t count) override
+    {
+        if(readWindow == readWindowEnd)
+        {
+            if(count >= buffer.size())
+                return reader->readUpTo(array, count);
+            if(count > 0)
+                fill();
+        }
+        return copyFromWindow(array, count);
+    }
+};
+
+/// a file mapped into memory and read without copying it into a buffer first
+class MmapReader final : public MemoryReader
+{
+private:
+    static pair<shared_ptr<const uint8_t>, size_t> mapFile(wstring fileName);
+    explicit MmapReader(pair<shared_ptr<const uint8_t>, size_t> mapping)
+        : MemoryReader(mapping.first, mapping.second)
+    {
+    }
+public:
+    /// @throws IOException if the file can't be opened or mapped
+    explicit MmapReader(wstring fileName)
+        : MmapReader(mapFile(fileName))
+    {
     }
 };
 
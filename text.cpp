@@ -18,6 +18,9 @@
 #include "text.h"
 #include "texture_atlas.h"
 #include <unordered_map>
+#include <list>
+#include <vector>
+#include <mutex>
 #include "util.h"
 #include <iostream>
 
@@ -329,38 +332,27 @@ int translateToCodePage437(wchar_t ch)
     }
 }
 
-Mesh charMesh[256];
-bool didInit = false;
+TextureDescriptor charTexture[256];
+once_flag initFlag;
 
 void init()
 {
-    if(didInit)
+    call_once(initFlag, []()
     {
-        return;
-    }
-
-    didInit = true;
-    for(size_t i = 0; i < sizeof(charMesh) / sizeof(charMesh[0]); i++)
-    {
-        int left = (i % (textureXRes / fontWidth)) * fontWidth;
-        int top = (i / (textureXRes / fontWidth)) * fontHeight;
-        const int width = fontWidth;
-        const int height = fontHeight;
-        float minU = (left + pixelOffset) / textureXRes;
-        float maxU = (left + width - pixelOffset) / textureXRes;
-        float minV = 1 - (top + height - pixelOffset) / textureYRes;
-        float maxV = 1 - (top + pixelOffset) / textureYRes;
-        TextureDescriptor texture = Font.tdNoOffset();
-        texture = texture.subTexture(minU, maxU, minV, maxV);
-        charMesh[i] = Generate::quadrilateral(texture, VectorF(0, 0, 0), Color(1), VectorF(1, 0, 0), Color(1), VectorF(1, 1, 0), Color(1), VectorF(0, 1, 0), Color(1));
-    }
-}
-
-void renderChar(Mesh dest, Matrix m, Color color, wchar_t ch)
-{
-    init();
-    //cout << "char:" << (char)ch << " pt:" << transform(m, VectorF(0, 0, 0)) << endl;
-    dest->add(scaleColors(color, transform(m, charMesh[translateToCodePage437(ch)])));
+        for(size_t i = 0; i < sizeof(charTexture) / sizeof(charTexture[0]); i++)
+        {
+            int left = (i % (textureXRes / fontWidth)) * fontWidth;
+            int top = (i / (textureXRes / fontWidth)) * fontHeight;
+            const int width = fontWidth;
+            const int height = fontHeight;
+            float minU = (left + pixelOffset) / textureXRes;
+            float maxU = (left + width - pixelOffset) / textureXRes;
+            float minV = 1 - (top + height - pixelOffset) / textureYRes;
+            float maxV = 1 - (top + pixelOffset) / textureYRes;
+            TextureDescriptor texture = Font.tdNoOffset();
+            charTexture[i] = texture.subTexture(minU, maxU, minV, maxV);
+        }
+    });
 }
 
 bool updateFromChar(float &x, float &y, float &w, float &h, wchar_t ch, const Text::TextProperties &properties)
@@ -399,70 +391,161 @@ bool updateFromChar(float &x, float &y, float &w, float &h, wchar_t ch, const Te
     }
     return false;
 }
-}
 
-float Text::width(wstring str, const TextProperties &properties)
+/// a character that needs a quad, at column x of line y
+struct Glyph
+{
+    float x, y;
+    int character;
+    Glyph(float x, float y, int character)
+        : x(x), y(y), character(character)
+    {
+    }
+};
+
+Text::TextLayout layoutText(const wstring &str, const Text::TextProperties &properties, vector<Glyph> *glyphs)
 {
     float x = 0, y = 0, w = 0, h = 0;
 
     for(wchar_t ch : str)
     {
-        updateFromChar(x, y, w, h, ch, properties);
+        float charX = x, charY = y;
+        if(updateFromChar(x, y, w, h, ch, properties) && glyphs != nullptr)
+        {
+            glyphs->push_back(Glyph(charX, charY, translateToCodePage437(ch)));
+        }
     }
 
-    return w;
+    Text::TextLayout retval;
+    retval.width = w;
+    retval.height = h;
+    retval.xPos = x;
+    retval.yPos = h - y - 1;
+    return retval;
 }
 
-float Text::height(wstring str, const TextProperties &properties)
+Mesh makeMesh(const wstring &str, Color color, const Text::TextProperties &properties)
 {
-    float x = 0, y = 0, w = 0, h = 0;
+    init();
+    vector<Glyph> glyphs;
+    glyphs.reserve(str.size());
+    float totalHeight = layoutText(str, properties, &glyphs).height;
+    Mesh retval(new Mesh_t(Font.texture));
+    retval->reserve(glyphs.size() * 2);
 
-    for(wchar_t ch : str)
+    for(const Glyph &glyph : glyphs)
     {
-        updateFromChar(x, y, w, h, ch, properties);
+        const TextureDescriptor &texture = charTexture[glyph.character];
+        float x = glyph.x, y = totalHeight - glyph.y - 1;
+        VectorF p1 = VectorF(x, y, 0), p2 = VectorF(x + charWidth, y, 0), p3 = VectorF(x + charWidth, y + charHeight, 0), p4 = VectorF(x, y + charHeight, 0);
+        TextureCoord t1 = TextureCoord(texture.minU, texture.minV), t2 = TextureCoord(texture.maxU, texture.minV), t3 = TextureCoord(texture.maxU, texture.maxV), t4 = TextureCoord(texture.minU, texture.maxV);
+        retval->add(Triangle(p1, color, t1, p2, color, t2, p3, color, t3));
+        retval->add(Triangle(p3, color, t3, p4, color, t4, p1, color, t1));
     }
 
-    return h;
+    return retval;
 }
 
-float Text::xPos(wstring str, const TextProperties &properties)
+struct MeshCacheKey
 {
-    float x = 0, y = 0, w = 0, h = 0;
+    wstring str;
+    Color color;
+    float tabWidth;
+    MeshCacheKey(const wstring &str, Color color, const Text::TextProperties &properties)
+        : str(str), color(color), tabWidth(properties.tabWidth)
+    {
+    }
+    bool operator ==(const MeshCacheKey &rt) const
+    {
+        return str == rt.str && color.r == rt.color.r && color.g == rt.color.g && color.b == rt.color.b && color.a == rt.color.a && tabWidth == rt.tabWidth;
+    }
+};
 
-    for(wchar_t ch : str)
+struct MeshCacheKeyHash
+{
+    size_t operator ()(const MeshCacheKey &key) const
+    {
+        hash<float> floatHash;
+        size_t retval = hash<wstring>()(key.str);
+        retval = retval * 31 + floatHash(key.color.r);
+        retval = retval * 31 + floatHash(key.color.g);
+        retval = retval * 31 + floatHash(key.color.b);
+        retval = retval * 31 + floatHash(key.color.a);
+        retval = retval * 31 + floatHash(key.tabWidth);
+        return retval;
+    }
+};
+
+/// the least recently used strings are removed once there are more than capacity
+class MeshCache final
+{
+private:
+    typedef list<pair<MeshCacheKey, Mesh>> ListType;
+    static constexpr size_t capacity = 128;
+    mutex lock;
+    ListType entries; // most recently used first
+    unordered_map<MeshCacheKey, ListType::iterator, MeshCacheKeyHash> entryMap;
+public:
+    Mesh find(const MeshCacheKey &key)
     {
-        updateFromChar(x, y, w, h, ch, properties);
+        lock_guard<mutex> lockIt(lock);
+        auto iter = entryMap.find(key);
+        if(iter == entryMap.end())
+            return nullptr;
+        entries.splice(entries.begin(), entries, iter->second);
+        return iter->second->second;
     }
+    void insert(const MeshCacheKey &key, Mesh mesh)
+    {
+        lock_guard<mutex> lockIt(lock);
+        if(entryMap.count(key) > 0)
+            return;
+        entries.push_front(make_pair(key, mesh));
+        entryMap.emplace(key, entries.begin());
+        if(entries.size() > capacity)
+        {
+            entryMap.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+};
 
-    return x;
+MeshCache meshCache;
 }
 
-float Text::yPos(wstring str, const TextProperties &properties)
+Text::TextLayout Text::layout(wstring str, const TextProperties &properties)
 {
-    float x = 0, y = 0, w = 0, h = 0;
+    return layoutText(str, properties, nullptr);
+}
 
-    for(wchar_t ch : str)
-    {
-        updateFromChar(x, y, w, h, ch, properties);
-    }
+float Text::width(wstring str, const TextProperties &properties)
+{
+    return layout(str, properties).width;
+}
 
-    return h - y - 1;
+float Text::height(wstring str, const TextProperties &properties)
+{
+    return layout(str, properties).height;
 }
 
-Mesh Text::mesh(wstring str, Color color, const TextProperties &properties)
+float Text::xPos(wstring str, const TextProperties &properties)
 {
-    float x = 0, y = 0, w = 0, h = 0;
-    float totalHeight = height(str, properties);
-    Mesh retval(new Mesh_t());
+    return layout(str, properties).xPos;
+}
 
-    for(wchar_t ch : str)
+float Text::yPos(wstring str, const TextProperties &properties)
+{
+    return layout(str, properties).yPos;
+}
+
+Mesh Text::mesh(wstring str, Color color, const TextProperties &properties)
+{
+    MeshCacheKey key(str, color, properties);
+    Mesh retval = meshCache.find(key);
+    if(retval == nullptr)
     {
-        Matrix mat = Matrix::translate(x, totalHeight - y - 1, 0);
-        if(updateFromChar(x, y, w, h, ch, properties))
-        {
-            renderChar(retval, mat, color, ch);
-        }
+        retval = makeMesh(str, color, properties);
+        meshCache.insert(key, retval);
     }
-
-    return retval;
+    return Mesh(new Mesh_t(*retval)); // copy it so callers can't change the cached mesh
 }
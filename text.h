@@ -31,10 +31,22 @@ namespace Text
         float tabWidth = 8;
     };
     extern const TextProperties defaultTextProperties;
+    /// the size of a string and where the text ends
+    struct TextLayout
+    {
+        float width = 0, height = 0, xPos = 0, yPos = 0;
+    };
+    /// @return all the measurements of str, found in one pass
+    TextLayout layout(wstring str, const TextProperties & properties = defaultTextProperties);
     float width(wstring str, const TextProperties & properties = defaultTextProperties);
     float height(wstring str, const TextProperties & properties = defaultTextProperties);
     float xPos(wstring str, const TextProperties & properties = defaultTextProperties);
     float yPos(wstring str, const TextProperties & properties = defaultTextProperties);
+    /** make the mesh for a string.
+     * recently used strings are cached so text that doesn't change isn't laid out again.
+     *
+     * @return a new copy of the mesh for str that the caller can modify
+     */
     Mesh mesh(wstring str, Color color = Color(1), const TextProperties & properties = defaultTextProperties);
 }
 
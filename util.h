@@ -34,6 +34,12 @@
 #include <condition_variable>
 #include <atomic>
 #include <iterator>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <algorithm>
 
 using namespace std;
 
@@ -235,6 +241,290 @@ public:
     }
 };
 
+/** lock-free triple buffer : one writer thread publishes new values while one reader thread reads the most recently published value without ever blocking either of them
+ */
+template <typename T>
+class TripleBuffer final
+{
+private:
+    static constexpr unsigned indexMask = 0x3, newValueFlag = 0x4;
+    T buffers[3];
+    atomic_uint middleState; // index of the buffer owned by neither thread, ored with newValueFlag if it holds an unread value
+    unsigned writeIndex = 0, readIndex = 1;
+    TripleBuffer(const TripleBuffer &) = delete;
+    const TripleBuffer &operator =(const TripleBuffer &) = delete;
+public:
+    TripleBuffer()
+        : middleState(2)
+    {
+    }
+    /// @return the buffer to fill in before calling publish. only call from the writer thread.
+    T &writeBuffer()
+    {
+        return buffers[writeIndex];
+    }
+    /// publish the contents of writeBuffer. only call from the writer thread.
+    void publish()
+    {
+        writeIndex = middleState.exchange(writeIndex | newValueFlag) & indexMask;
+    }
+    /// switch to the most recently published value, if there is a new one. only call from the reader thread.
+    /// @return if there was a new value
+    bool update()
+    {
+        if((middleState.load() & newValueFlag) == 0)
+        {
+            return false;
+        }
+
+        readIndex = middleState.exchange(readIndex) & indexMask;
+        return true;
+    }
+    /// @return the value read by the last call to update. only call from the reader thread.
+    const T &readBuffer() const
+    {
+        return buffers[readIndex];
+    }
+};
+
+/** a pool of worker threads for running small jobs in parallel.
+ * each worker has its own queue : it runs its newest job first and, once its queue is empty, steals the oldest job from another queue.
+ * threads waiting for a Group run queued jobs and only block once there are none, so jobs can start other jobs and wait for them.
+ */
+class JobSystem final
+{
+public:
+    /// a set of jobs that can be waited for together
+    class Group final
+    {
+        friend class JobSystem;
+    private:
+        atomic_size_t remaining;
+        mutex lock;
+        exception_ptr error;
+        Group(const Group &) = delete;
+        const Group &operator =(const Group &) = delete;
+    public:
+        Group()
+            : remaining(0)
+        {
+        }
+    };
+private:
+    struct Job
+    {
+        function<void()> fn;
+        Group * group = nullptr;
+    };
+    struct WorkerQueue
+    {
+        mutex lock;
+        deque<Job> jobs;
+    };
+    struct ThreadState
+    {
+        const JobSystem * jobSystem;
+        size_t index;
+    };
+    vector<unique_ptr<WorkerQueue>> queues; // one for each worker then one shared by all the other threads
+    vector<thread> threads;
+    mutex sleepLock;
+    condition_variable sleepCond;
+    atomic_size_t queuedJobCount;
+    bool done = false;
+    JobSystem(const JobSystem &) = delete;
+    const JobSystem &operator =(const JobSystem &) = delete;
+    static ThreadState &threadState()
+    {
+        static thread_local ThreadState state = {nullptr, 0};
+        return state;
+    }
+    size_t currentQueueIndex() const
+    {
+        const ThreadState &state = threadState();
+        if(state.jobSystem == this)
+            return state.index;
+        return threads.size();
+    }
+    bool tryGetJob(size_t index, Job &job)
+    {
+        for(size_t i = 0; i < queues.size(); i++)
+        {
+            WorkerQueue &queue = *queues[(index + i) % queues.size()];
+            lock_guard<mutex> lockIt(queue.lock);
+            if(queue.jobs.empty())
+                continue;
+            if(i == 0)
+            {
+                job = move(queue.jobs.back());
+                queue.jobs.pop_back();
+            }
+            else
+            {
+                job = move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            queuedJobCount--;
+            return true;
+        }
+        return false;
+    }
+    void execute(Job &job)
+    {
+        Group &group = *job.group;
+        try
+        {
+            job.fn();
+        }
+        catch(...)
+        {
+            lock_guard<mutex> lockIt(group.lock);
+            if(!group.error)
+                group.error = current_exception();
+        }
+        job = Job();
+        if(--group.remaining == 0) // the group can be destroyed as soon as this is done
+        {
+            {
+                lock_guard<mutex> lockIt(sleepLock);
+            }
+            sleepCond.notify_all(); // wake the threads waiting for the group
+        }
+    }
+    void workerThread(size_t index)
+    {
+        threadState() = ThreadState{this, index};
+        Job job;
+        while(true)
+        {
+            if(tryGetJob(index, job))
+            {
+                execute(job);
+                continue;
+            }
+            unique_lock<mutex> lockIt(sleepLock);
+            if(done)
+                return;
+            if(queuedJobCount.load() == 0)
+                sleepCond.wait(lockIt);
+        }
+    }
+public:
+    /// @param workerCount the number of threads to start. the threads that wait for jobs run them too.
+    explicit JobSystem(size_t workerCount = max<size_t>(thread::hardware_concurrency(), 1) - 1)
+        : queuedJobCount(0)
+    {
+        for(size_t i = 0; i <= workerCount; i++)
+            queues.push_back(unique_ptr<WorkerQueue>(new WorkerQueue));
+        for(size_t i = 0; i < workerCount; i++)
+            threads.push_back(thread([this, i]()
+            {
+                workerThread(i);
+            }));
+    }
+    ~JobSystem()
+    {
+        {
+            lock_guard<mutex> lockIt(sleepLock);
+            done = true;
+        }
+        sleepCond.notify_all();
+        for(thread &t : threads)
+            t.join();
+    }
+    /// @return the job system shared by the whole program
+    static JobSystem &global()
+    {
+        static JobSystem retval;
+        return retval;
+    }
+    size_t workerCount() const
+    {
+        return threads.size();
+    }
+    /// @return the number of pieces to split work into so all the threads stay busy
+    size_t defaultChunkCount() const
+    {
+        return 4 * (threads.size() + 1);
+    }
+    /// start running fn as part of group
+    void run(Group &group, function<void()> fn)
+    {
+        group.remaining++;
+        WorkerQueue &queue = *queues[currentQueueIndex()];
+        {
+            lock_guard<mutex> lockIt(queue.lock);
+            Job job;
+            job.fn = move(fn);
+            job.group = &group;
+            queuedJobCount++;
+            queue.jobs.push_back(move(job));
+        }
+        {
+            lock_guard<mutex> lockIt(sleepLock);
+        }
+        sleepCond.notify_one();
+    }
+    /// run jobs until all the jobs in group are finished, then rethrow the first exception thrown by any of them
+    void wait(Group &group)
+    {
+        size_t index = currentQueueIndex();
+        Job job;
+        while(group.remaining.load() > 0)
+        {
+            if(tryGetJob(index, job))
+            {
+                execute(job);
+                continue;
+            }
+            unique_lock<mutex> lockIt(sleepLock);
+            if(group.remaining.load() > 0 && queuedJobCount.load() == 0)
+                sleepCond.wait(lockIt);
+        }
+        if(group.error)
+        {
+            exception_ptr error = group.error;
+            group.error = nullptr;
+            rethrow_exception(error);
+        }
+    }
+    /** split [0, count) into at most chunkCount contiguous ranges and call fn(chunk, begin, end) for each in parallel
+     *
+     * @param count the number of items
+     * @param chunkCount the maximum number of ranges. chunk is always less than this.
+     * @param fn the function to call for each range
+     */
+    void parallelForRanges(size_t count, size_t chunkCount, function<void(size_t chunk, size_t begin, size_t end)> fn)
+    {
+        chunkCount = min(chunkCount, count);
+        if(chunkCount <= 1)
+        {
+            if(count > 0)
+                fn(0, 0, count);
+            return;
+        }
+        Group group;
+        for(size_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            size_t begin = count * chunk / chunkCount, end = count * (chunk + 1) / chunkCount;
+            run(group, [&fn, chunk, begin, end]()
+            {
+                fn(chunk, begin, end);
+            });
+        }
+        wait(group);
+    }
+    /// call fn(index) for every index in [0, count) in parallel
+    void parallelFor(size_t count, function<void(size_t index)> fn)
+    {
+        parallelForRanges(count, defaultChunkCount(), [&fn](size_t, size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+                fn(i);
+        });
+    }
+};
+
 template <typename T, size_t arraySize>
 class circularDeque final
 {